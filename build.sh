@@ -5,6 +5,7 @@ kernel_src_dir="/usr/src/linux-headers-$(uname -r)"
 build_all=true
 build_codec=false
 build_overlay=false
+build_tools=false
 make_args=''
 dtc_path=''
 
@@ -15,7 +16,7 @@ usage_str="$(basename "$0") [-h] [-d dir] [-b target] [-a args] [-t dtc] -- Buil
 where:
     -h  show this help text
     -d  set the source directory
-    -b  set the build targets codec, or overlay
+    -b  set the build targets codec, overlay, or tools
     -a  arguments to pass to make
     -t  specify an alternative dtc"
 
@@ -33,6 +34,8 @@ while getopts $options opt; do
             build_codec=true
         elif [ "$OPTARG" = 'overlay' ]; then
             build_overlay=true
+        elif [ "$OPTARG" = 'tools' ]; then
+            build_tools=true
         else
             echo -e "\n *** Error: Unrecognized build target $OPTARG\n" >&2; usage; exit 1;
         fi
@@ -73,3 +76,9 @@ if [ "$build_all" = true ] || [ "$build_overlay" = true ]; then
         $dtc_path -@ -I dts -O dtb -o rpi-tscs42xx-overlay.dtbo rpi-tscs42xx-overlay.dts
     fi
 fi
+
+if [ "$build_tools" = true ]; then
+    echo "Building tools in $root/tools/tscs42xx/"
+    cd "$root/tools/tscs42xx/"
+    make $make_args
+fi
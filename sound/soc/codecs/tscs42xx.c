@@ -12,7 +12,23 @@
 #include <linux/module.h>
 #include <linux/delay.h>
 #include <linux/mutex.h>
+#include <linux/compiler.h>
+#include <linux/workqueue.h>
+#include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/bitmap.h>
+#include <linux/math64.h>
+#include <linux/list.h>
+#include <linux/property.h>
+#include <linux/log2.h>
+#include <linux/atomic.h>
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/pm_qos.h>
 #include <linux/clk.h>
+#include <linux/firmware.h>
 #include <sound/tlv.h>
 #include <sound/pcm_params.h>
 #include <sound/soc.h>
@@ -28,22 +44,286 @@
 #define COEFF_RAM_COEFF_COUNT (COEFF_RAM_MAX_ADDR + 1)
 #define COEFF_RAM_SIZE (COEFF_SIZE * COEFF_RAM_COEFF_COUNT)
 
+/* Coefficients per coeff_regmap access, bounds how long readers wait */
+#define COEFF_BURST_COUNT BIQUAD_COEFF_COUNT
+
+enum {
+	DSP_BYPASS_EQ,
+	DSP_BYPASS_FX,
+	DSP_BYPASS_MBC,
+	DSP_BYPASS_CNT,
+};
+
+enum {
+	PROFILE_SPEAKER,
+	PROFILE_HEADPHONE,
+	PROFILE_CNT,
+};
+
+/* Output path DSP profile blob, see profile_apply() */
+struct profile_hdr {
+	char magic[4];
+	__le16 version;
+	__le16 num_regs;
+} __packed;
+
+/* Whole device checkpoint, see state_write() */
+struct state_hdr {
+	char magic[4];
+	__le16 version;
+	__le16 num_regs;
+} __packed;
+
+#define STATE_VERSION 1
+#define STATE_MAX_SIZE (sizeof(struct state_hdr) + COEFF_RAM_SIZE + \
+	(R_DACMBCREL3H + 1) * 2)
+
+#define PROFILE_MAX_REGS 64
+#define PROFILE_MAX_SIZE (sizeof(struct profile_hdr) + COEFF_RAM_SIZE + \
+	PROFILE_MAX_REGS * 2)
+
+struct tscs42xx_profile {
+	u8 data[PROFILE_MAX_SIZE];
+	unsigned int size;	/* 0 when unset */
+};
+
+enum {
+	TIME_CONST_CLE_ATK,
+	TIME_CONST_MBC1_ATK,
+	TIME_CONST_MBC1_REL,
+	TIME_CONST_MBC2_ATK,
+	TIME_CONST_MBC2_REL,
+	TIME_CONST_MBC3_ATK,
+	TIME_CONST_MBC3_REL,
+	TIME_CONST_CNT,
+};
+
+/* Time a power bit or widget spent on, see power_account() */
+struct power_stat {
+	struct snd_soc_dapm_widget *widget;
+	bool on;
+	u64 since_ns;
+	u64 on_ns;
+	unsigned int ups;
+	u32 microamp;
+};
+
+/* Bus journal entry, layout shared with tools/tscs42xx/journal.h */
+struct journal_entry {
+	__le64 ts_ns;
+	__le32 dur_ns;
+	u8 reg;
+	u8 len;
+	u8 path;
+	u8 flags;
+	u8 val[4];
+} __packed;
+
+struct tscs42xx_journal {
+	struct i2c_client *i2c;
+	struct journal_entry *ring;	/* NULL when disabled */
+	unsigned int mask;
+	atomic64_t head;
+	u8 path;
+};
+
+/* Bus I/O priority classes, see io_begin() */
+enum {
+	IO_CRITICAL,
+	IO_INTERACTIVE,
+	IO_BACKGROUND,
+	IO_CLASS_CNT,
+};
+
+struct tscs42xx_io {
+	spinlock_t lock;		/* everything below */
+	wait_queue_head_t wq;
+	unsigned int active[IO_CLASS_CNT];
+	unsigned int bg_running;
+
+	/* Statistics, queueing delay in nanoseconds */
+	struct io_class_stats {
+		unsigned int grants;
+		u64 wait_ns;
+		u64 max_wait_ns;
+	} stats[IO_CLASS_CNT];
+	unsigned int bg_yields;
+};
+
+/* A staged coefficient image applied at a playback frame position */
+struct coeff_sched {
+	struct mutex lock;	/* staged, dirty, staging and statistics */
+	bool staging;
+	u8 staged[COEFF_RAM_SIZE];
+	DECLARE_BITMAP(dirty, COEFF_RAM_COEFF_COUNT);
+
+	spinlock_t stream_lock;	/* substream, target, last_ptr, last_ts */
+	struct snd_pcm_substream *substream;
+	s64 target;		/* -1 when not armed */
+	snd_pcm_uframes_t last_ptr;
+	ktime_t last_ts;
+
+	struct hrtimer timer;
+	struct work_struct work;
+
+	/* Statistics, in frames and microseconds */
+	s64 last_err;
+	s64 max_err;
+	unsigned int flush_us;
+	unsigned int late_cnt;
+};
+
+/*
+ * Locking
+ *
+ * Lock order, outermost first:
+ *
+ *	sched->lock -> tscs42xx_group_lock -> group->lock -> coeff_ram_lock
+ *	profile_lock, state_lock -> bypass_lock -> time_const_lock -> regmap
+ *	profile_lock, state_lock, loudness_lock, ramp->lock -> coeff_ram_lock
+ *	coeff_ram_lock -> pll_lock -> coeff_regmap -> regmap
+ *
+ * coeff_ram_lock serializes coefficient RAM writers and flushes along with
+ * the cache only state and dirty range of coeff_regmap. Readers only take
+ * the regmap lock, which writers and flushes drop after every
+ * COEFF_BURST_COUNT coefficients. pll_lock serializes PLL power changes
+ * against coefficient writes and is never held across the PLL lock wait.
+ *
+ * tscs42xx_group_lock protects the group list. Each group's lock covers
+ * its member list and jobs and is held across that group's fan out.
+ *
+ * sched->stream_lock is a spinlock shared with the trigger callback and
+ * the hrtimer and nests inside everything else. power_lock and qos_lock
+ * are leaves.
+ *
+ * I/O classes (struct tscs42xx_io) are claimed before any driver lock is
+ * taken and background uploads only wait for them between chunks, with
+ * no driver lock held. No foreground path takes loudness_lock, so it may
+ * stay held across that wait.
+ *
+ * loudness_en is written under loudness_lock and read locklessly by
+ * loudness_owns(). bclk_ratio, bclk_ratio_fixed, slot_width and samplerate
+ * are published with WRITE_ONCE()/READ_ONCE().
+ */
 struct tscs42xx {
 
 	int bclk_ratio;
+	bool bclk_ratio_fixed;
+	int slot_width;		/* 0 unless set through set_tdm_slot */
 	int samplerate;
-	struct mutex audio_params_lock;
 
-	u8 coeff_ram[COEFF_RAM_SIZE];
-	bool coeff_ram_synced;
+	/* Coefficient RAM, see coeff_bus_write() */
+	struct regmap *coeff_regmap;
+	bool coeff_ram_dirty;
+	unsigned int coeff_dirty_lo;
+	unsigned int coeff_dirty_hi;
 	struct mutex coeff_ram_lock;
 
 	struct mutex pll_lock;
 
+	/* Loudness compensation, see loudness_work() */
+	struct mutex loudness_lock;	/* switching and shelf updates */
+	bool loudness_en;
+	struct delayed_work loudness_work;
+
+	struct coeff_sched sched;
+
+	/* Parameter ramp, see ramp_work() */
+	struct tscs42xx_ramp {
+		struct mutex lock;	/* everything below */
+		struct hrtimer timer;
+		struct work_struct work;
+		unsigned int sel;
+		unsigned int value;
+		unsigned int duration_ms;
+		bool running;
+		u64 start_ns;
+		u64 dur_ns;
+		int from[2];
+		int last[2];
+		unsigned int keep[2];
+		int to;
+		struct snd_kcontrol *kctl;
+	} ramp;
+
+	/* Stream open pre-warm, see warm_work() */
+	struct work_struct warm_work;
+	bool warm_pll;
+	int warm_pll_freq;
+	int warm_users;
+
+	/* Deferred converter mute, see mute_work() */
+	unsigned long mute_want;
+	unsigned long unmute_armed;
+	struct work_struct mute_work;
+
+	/* 48 kHz referenced dynamics time constants, see time_const_update() */
+	struct mutex time_const_lock;
+	u16 time_const[TIME_CONST_CNT];
+	int time_const_rate;
+
+	/* DC removal corner, 0 picks it per rate, see dc_coef_update() */
+	unsigned int dc_coef_sel;
+
+	/* Mono capture drops the right analog path, see capture_stereo() */
+	bool capture_mono;
+
+	/* Speaker and headphone DSP profiles, see profile_update() */
+	struct mutex profile_lock;
+	struct tscs42xx_profile profiles[PROFILE_CNT];
+	int profile_active;
+
+	/* Serializes checkpoint restores, see state_write() */
+	struct mutex state_lock;
+
+	/* CPU latency request, see qos_get() */
+	struct mutex qos_lock;
+	struct pm_qos_request qos_req;
+	unsigned int qos_users;
+	unsigned long qos_streams;
+	struct delayed_work qos_timeout;
+	u64 qos_since_ns;
+	struct tscs42xx_qos_stats {
+		unsigned int holds;
+		u64 held_ns;
+		unsigned int uploads[2];	/* without, with QoS */
+		u64 upload_ns[2];
+	} qos_stats;
+
+	/* Power accounting, see power_account() */
+	struct mutex power_lock;
+	struct power_stat *power_blocks;
+	struct power_stat *power_widgets;
+	unsigned int num_power_widgets;
+
+	/* Low latency DSP bypass, see dsp_bypass_update() */
+	unsigned int bypass_period;
+	unsigned int bypass_blocks;
+	struct mutex bypass_lock;	/* the three below */
+	bool bypassed;
+	unsigned int bypass_active;	/* blocks cleared for this stream */
+	unsigned int bypass_saved[DSP_BYPASS_CNT];
+
+	/* Instances sharing a group id get coefficient writes fanned out */
+	struct tscs42xx_group *group;	/* NULL when not grouped */
+	struct list_head group_node;
+	struct tscs42xx_group_job {
+		unsigned int addr;
+		unsigned int coeff_cnt;
+		u8 data[COEFF_RAM_SIZE];
+		int ret;
+		struct work_struct work;
+	} group_job;
+
+	const struct tscs42xx_variant *variant;
+	struct snd_soc_component *component;
 	struct regmap *regmap;
+	struct tscs42xx_journal journal;
+	struct tscs42xx_io io;
 
-	struct clk *sysclk;
-	int sysclk_src_id;
+	/* PLL1 (48k family) and PLL2 (44.1k family) references */
+	struct clk *sysclk[2];
+	int sysclk_src_id[2];
 };
 
 struct coeff_ram_ctl {
@@ -63,6 +343,8 @@ static bool tscs42xx_volatile(struct device *dev, unsigned int reg)
 	case R_DACCRSTAT:
 	case R_DACCRADDR:
 	case R_PLLCTL0:
+	/* Write only trigger, must never be replayed by a cache sync */
+	case R_RESET:
 		return true;
 	default:
 		return false;
@@ -96,314 +378,3506 @@ static const struct regmap_config tscs42xx_regmap = {
 	.can_multi_write = true,
 };
 
-#define MAX_PLL_LOCK_20MS_WAITS 1
-static bool plls_locked(struct snd_soc_component *component)
+/*
+ * Bus journal
+ *
+ * With journal_entries set, the regmap runs on a small I2C bus of its own
+ * that logs every transfer, coefficient RAM traffic included, into a per
+ * instance ring: start time, register, up to four values, the driver path
+ * that caused it and the transfer time. Writers claim slots with an
+ * atomic counter and never wait, so an entry being filled in while the
+ * ring is dumped can be torn. The path is a hint set at the driver entry
+ * points; concurrent paths can tag each other's accesses.
+ *
+ * debugfs "journal" dumps the ring oldest first behind a small header.
+ * tools/tscs42xx/tscs42xx-journal decodes and replays it.
+ */
+#define JOURNAL_MAX_ENTRIES (1 << 20)
+#define JOURNAL_VERSION 1
+
+#define JOURNAL_READ BIT(0)
+#define JOURNAL_ERR BIT(1)
+
+enum {
+	JOURNAL_PATH_OTHER,
+	JOURNAL_PATH_PROBE,
+	JOURNAL_PATH_HW_PARAMS,
+	JOURNAL_PATH_DAPM,
+	JOURNAL_PATH_COEFF,
+	JOURNAL_PATH_MUTE,
+	JOURNAL_PATH_WORK,
+};
+
+struct journal_header {
+	char magic[4];
+	__le16 version;
+	__le16 entry_size;
+	__le32 count;
+	__le32 dropped;
+} __packed;
+
+static unsigned int journal_entries;
+module_param(journal_entries, uint, 0444);
+MODULE_PARM_DESC(journal_entries,
+	"Bus journal size in entries, rounded up to a power of two (0 = off)");
+
+static inline u8 journal_path_push(struct tscs42xx *tscs42xx, u8 path)
 {
-	int ret;
-	int count = MAX_PLL_LOCK_20MS_WAITS;
-    unsigned int val;
+	u8 old = READ_ONCE(tscs42xx->journal.path);
 
-	do {
-		ret = snd_soc_component_read(component, R_PLLCTL0, &val);
-		if (ret < 0) {
-			dev_err(component->dev,
-				"Failed to read PLL lock status (%d)\n", ret);
-			return false;
-		} else if (val > 0) {
-			return true;
-		}
-		msleep(20);
-	} while (count--);
+	WRITE_ONCE(tscs42xx->journal.path, path);
 
-	return false;
+	return old;
 }
 
-static int sample_rate_to_pll_freq_out(int sample_rate)
+static inline void journal_path_pop(struct tscs42xx *tscs42xx, u8 old)
 {
-	switch (sample_rate) {
-	case 11025:
-	case 22050:
-	case 44100:
-	case 88200:
-		return 112896000;
-	case 8000:
-	case 16000:
-	case 32000:
-	case 48000:
-	case 96000:
-		return 122880000;
-	default:
-		return -EINVAL;
-	}
+	WRITE_ONCE(tscs42xx->journal.path, old);
 }
 
-#define DACCRSTAT_MAX_TRYS 10
-static int write_coeff_ram(struct snd_soc_component *component, u8 *coeff_ram,
-	unsigned int addr, unsigned int coeff_cnt)
+static void journal_add(struct tscs42xx_journal *journal, u64 t0, u8 reg,
+	const u8 *val, size_t len, u8 flags)
 {
-	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
-	int cnt;
-	int trys;
-	int ret;
-    unsigned int val;
-
-	for (cnt = 0; cnt < coeff_cnt; cnt++, addr++) {
+	u32 dur = ktime_get_ns() - t0;
+	struct journal_entry *e;
+	size_t n;
 
-		for (trys = 0; trys < DACCRSTAT_MAX_TRYS; trys++) {
-			ret = snd_soc_component_read(component, R_DACCRSTAT, &val);
-			if (ret < 0) {
-				dev_err(component->dev,
-					"Failed to read stat (%d)\n", ret);
-				return ret;
-			}
-			if (!val)
-				break;
-		}
+	/* Long bursts take one entry per four registers */
+	do {
+		n = min_t(size_t, len, ARRAY_SIZE(e->val));
+		e = &journal->ring[(atomic64_inc_return(&journal->head) - 1) &
+			journal->mask];
+		e->ts_ns = cpu_to_le64(t0);
+		e->dur_ns = cpu_to_le32(dur);
+		e->reg = reg;
+		e->len = n;
+		e->path = READ_ONCE(journal->path);
+		e->flags = flags;
+		memset(e->val, 0, sizeof(e->val));
+		memcpy(e->val, val, n);
+		reg += n;
+		val += n;
+		len -= n;
+	} while (len);
+}
 
-		if (trys == DACCRSTAT_MAX_TRYS) {
-			ret = -EIO;
-			dev_err(component->dev,
-				"dac coefficient write error (%d)\n", ret);
-			return ret;
-		}
+static int journal_bus_write(void *context, const void *data, size_t count)
+{
+	struct tscs42xx_journal *journal = context;
+	const u8 *buf = data;
+	u64 t0 = ktime_get_ns();
+	int ret;
 
-		ret = regmap_write(tscs42xx->regmap, R_DACCRADDR, addr);
-		if (ret < 0) {
-			dev_err(component->dev,
-				"Failed to write dac ram address (%d)\n", ret);
-			return ret;
-		}
+	ret = i2c_master_send(journal->i2c, data, count);
+	if (ret == count)
+		ret = 0;
+	else if (ret >= 0)
+		ret = -EIO;
 
-		ret = regmap_bulk_write(tscs42xx->regmap, R_DACCRWRL,
-			&coeff_ram[addr * COEFF_SIZE],
-			COEFF_SIZE);
-		if (ret < 0) {
-			dev_err(component->dev,
-				"Failed to write dac ram (%d)\n", ret);
-			return ret;
-		}
-	}
+	journal_add(journal, t0, buf[0], buf + 1, count - 1,
+		ret ? JOURNAL_ERR : 0);
 
-	return 0;
+	return ret;
 }
 
-static int power_up_audio_plls(struct snd_soc_component *component)
+static int journal_bus_read(void *context, const void *reg_buf,
+	size_t reg_size, void *val_buf, size_t val_size)
 {
-	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
-	int freq_out;
+	struct tscs42xx_journal *journal = context;
+	struct i2c_client *i2c = journal->i2c;
+	struct i2c_msg xfer[2] = {
+		{
+			.addr = i2c->addr,
+			.len = reg_size,
+			.buf = (void *)reg_buf,
+		},
+		{
+			.addr = i2c->addr,
+			.flags = I2C_M_RD,
+			.len = val_size,
+			.buf = val_buf,
+		},
+	};
+	u64 t0 = ktime_get_ns();
 	int ret;
-	unsigned int mask;
-	unsigned int val;
-
-	freq_out = sample_rate_to_pll_freq_out(tscs42xx->samplerate);
-	switch (freq_out) {
-	case 122880000: /* 48k */
-		mask = RM_PLLCTL1C_PDB_PLL1;
-		val = RV_PLLCTL1C_PDB_PLL1_ENABLE;
-		break;
-	case 112896000: /* 44.1k */
-		mask = RM_PLLCTL1C_PDB_PLL2;
-		val = RV_PLLCTL1C_PDB_PLL2_ENABLE;
-		break;
-	default:
-		ret = -EINVAL;
-		dev_err(component->dev,
-				"Unrecognized PLL output freq (%d)\n", ret);
-		return ret;
-	}
 
-	mutex_lock(&tscs42xx->pll_lock);
+	ret = i2c_transfer(i2c->adapter, xfer, ARRAY_SIZE(xfer));
+	if (ret == ARRAY_SIZE(xfer))
+		ret = 0;
+	else if (ret >= 0)
+		ret = -EIO;
 
-	ret = snd_soc_component_update_bits(component, R_PLLCTL1C, mask, val);
-	if (ret < 0) {
-		dev_err(component->dev, "Failed to turn PLL on (%d)\n", ret);
-		goto exit;
-	}
+	journal_add(journal, t0, *(const u8 *)reg_buf, val_buf, val_size,
+		JOURNAL_READ | (ret ? JOURNAL_ERR : 0));
 
-	if (!plls_locked(component)) {
-		dev_err(component->dev, "Failed to lock plls\n");
-		ret = -ENOMSG;
-		goto exit;
-	}
+	return ret;
+}
 
-	ret = 0;
-exit:
-	mutex_unlock(&tscs42xx->pll_lock);
+static const struct regmap_bus journal_bus = {
+	.write = journal_bus_write,
+	.read = journal_bus_read,
+};
 
-	return ret;
+static void journal_free(void *data)
+{
+	kvfree(data);
 }
 
-static int power_down_audio_plls(struct snd_soc_component *component)
+static struct regmap *journal_regmap_init(struct i2c_client *i2c,
+	struct tscs42xx *tscs42xx)
 {
-	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	struct tscs42xx_journal *journal = &tscs42xx->journal;
+	struct regmap_config config = tscs42xx_regmap;
+	unsigned int size;
 	int ret;
 
-	mutex_lock(&tscs42xx->pll_lock);
+	size = roundup_pow_of_two(min_t(unsigned int, journal_entries,
+		JOURNAL_MAX_ENTRIES));
+	journal->ring = kvcalloc(size, sizeof(*journal->ring), GFP_KERNEL);
+	if (!journal->ring)
+		return ERR_PTR(-ENOMEM);
+	ret = devm_add_action_or_reset(&i2c->dev, journal_free,
+		journal->ring);
+	if (ret < 0)
+		return ERR_PTR(ret);
 
-	ret = snd_soc_component_update_bits(component, R_PLLCTL1C,
-			RM_PLLCTL1C_PDB_PLL1,
-			RV_PLLCTL1C_PDB_PLL1_DISABLE);
-	if (ret < 0) {
-		dev_err(component->dev, "Failed to turn PLL off (%d)\n", ret);
-		goto exit;
-	}
-	ret = snd_soc_component_update_bits(component, R_PLLCTL1C,
-			RM_PLLCTL1C_PDB_PLL2,
-			RV_PLLCTL1C_PDB_PLL2_DISABLE);
-	if (ret < 0) {
-		dev_err(component->dev, "Failed to turn PLL off (%d)\n", ret);
-		goto exit;
-	}
+	journal->i2c = i2c;
+	journal->mask = size - 1;
+	atomic64_set(&journal->head, 0);
 
-	ret = 0;
-exit:
-	mutex_unlock(&tscs42xx->pll_lock);
+	/* Multi writes interleave registers and values, keep them apart */
+	config.can_multi_write = false;
 
-	return ret;
+	return devm_regmap_init(&i2c->dev, &journal_bus, journal, &config);
 }
 
-static int coeff_ram_get(struct snd_kcontrol *kcontrol,
-	struct snd_ctl_elem_value *ucontrol)
+#ifdef CONFIG_DEBUG_FS
+static int journal_open(struct inode *inode, struct file *file)
 {
-	struct snd_soc_component *component =
-		snd_soc_kcontrol_component(kcontrol);
-	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
-	struct coeff_ram_ctl *ctl =
-		(struct coeff_ram_ctl *)kcontrol->private_value;
-	struct soc_bytes_ext *params = &ctl->bytes_ext;
+	struct tscs42xx_journal *journal = inode->i_private;
+	struct journal_header *hdr;
+	size_t size = journal->mask + 1;
+	u64 head = atomic64_read(&journal->head);
+	u32 count = min_t(u64, head, size);
+	u64 i;
+	void *buf;
+
+	buf = kvmalloc(sizeof(*hdr) + count * sizeof(*journal->ring),
+		GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	hdr = buf;
+	memcpy(hdr->magic, "T42J", sizeof(hdr->magic));
+	hdr->version = cpu_to_le16(JOURNAL_VERSION);
+	hdr->entry_size = cpu_to_le16(sizeof(*journal->ring));
+	hdr->count = cpu_to_le32(count);
+	hdr->dropped = cpu_to_le32(min_t(u64, head - count, U32_MAX));
+
+	for (i = 0; i < count; i++)
+		memcpy(buf + sizeof(*hdr) + i * sizeof(*journal->ring),
+			&journal->ring[(head - count + i) & journal->mask],
+			sizeof(*journal->ring));
+
+	file->private_data = buf;
+
+	return nonseekable_open(inode, file);
+}
 
-	mutex_lock(&tscs42xx->coeff_ram_lock);
+static ssize_t journal_read(struct file *file, char __user *ubuf,
+	size_t count, loff_t *ppos)
+{
+	struct journal_header *hdr = file->private_data;
 
-	memcpy(ucontrol->value.bytes.data,
-		&tscs42xx->coeff_ram[ctl->addr * COEFF_SIZE], params->max);
+	return simple_read_from_buffer(ubuf, count, ppos, hdr, sizeof(*hdr) +
+		le32_to_cpu(hdr->count) * sizeof(struct journal_entry));
+}
 
-	mutex_unlock(&tscs42xx->coeff_ram_lock);
+static int journal_release(struct inode *inode, struct file *file)
+{
+	kvfree(file->private_data);
 
 	return 0;
 }
 
-static int coeff_ram_put(struct snd_kcontrol *kcontrol,
-	struct snd_ctl_elem_value *ucontrol)
+static const struct file_operations journal_fops = {
+	.owner = THIS_MODULE,
+	.open = journal_open,
+	.read = journal_read,
+	.release = journal_release,
+};
+
+static void journal_debugfs_init(struct snd_soc_component *component)
 {
-	struct snd_soc_component *component =
-		snd_soc_kcontrol_component(kcontrol);
 	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
-	struct coeff_ram_ctl *ctl =
-		(struct coeff_ram_ctl *)kcontrol->private_value;
-	struct soc_bytes_ext *params = &ctl->bytes_ext;
-	unsigned int coeff_cnt = params->max / COEFF_SIZE;
-	int ret;
 
-	mutex_lock(&tscs42xx->coeff_ram_lock);
+	if (tscs42xx->journal.ring)
+		debugfs_create_file("journal", 0400, component->debugfs_root,
+			&tscs42xx->journal, &journal_fops);
+}
+#else
+static inline void journal_debugfs_init(struct snd_soc_component *component)
+{
+}
+#endif
+
+/*
+ * CPU latency QoS
+ *
+ * Deep idle states entered between I2C completions stretch every round
+ * trip of coefficient uploads, PLL lock polling and DAPM sequences. A CPU
+ * latency request of qos_latency_us is held from hw_params until the
+ * stream is unmuted, at most QOS_STREAM_HOLD_MS so a stream that is set
+ * up but never started does not keep the CPUs out of idle, and around
+ * bulk coefficient uploads. It is dropped as soon as the last holder is
+ * done. A negative value turns it off.
+ *
+ * debugfs "qos" splits bulk upload times by whether the request was in
+ * force when the upload started. Plain uploads only happen with
+ * qos_latency_us < 0, so the time saved is estimated only once both kinds
+ * have been seen, e.g. by running with the request off for a while.
+ */
+#define QOS_STREAM_HOLD_MS 500
+
+/* A bulk upload, see qos_upload_begin() */
+struct qos_upload {
+	u64 t0;
+	bool held;	/* request in force at t0 */
+};
 
-	tscs42xx->coeff_ram_synced = false;
+static int qos_latency_us = 300;
+module_param(qos_latency_us, int, 0644);
+MODULE_PARM_DESC(qos_latency_us,
+	"CPU latency limit in us during bring-up and uploads (<0 = off)");
 
-	memcpy(&tscs42xx->coeff_ram[ctl->addr * COEFF_SIZE],
-		ucontrol->value.bytes.data, params->max);
+static void qos_get(struct tscs42xx *tscs42xx)
+{
+	int latency = READ_ONCE(qos_latency_us);
 
-	mutex_lock(&tscs42xx->pll_lock);
+	mutex_lock(&tscs42xx->qos_lock);
 
-	if (plls_locked(component)) {
-		ret = write_coeff_ram(component, tscs42xx->coeff_ram,
-			ctl->addr, coeff_cnt);
-		if (ret < 0) {
-			dev_err(component->dev,
-				"Failed to flush coeff ram cache (%d)\n", ret);
-			goto exit;
-		}
-		tscs42xx->coeff_ram_synced = true;
+	if (!tscs42xx->qos_users++ && latency >= 0) {
+		cpu_latency_qos_add_request(&tscs42xx->qos_req, latency);
+		tscs42xx->qos_since_ns = ktime_get_ns();
+		tscs42xx->qos_stats.holds++;
 	}
 
-	ret = 0;
-exit:
-	mutex_unlock(&tscs42xx->pll_lock);
+	mutex_unlock(&tscs42xx->qos_lock);
+}
 
-	mutex_unlock(&tscs42xx->coeff_ram_lock);
+static void qos_put(struct tscs42xx *tscs42xx)
+{
+	mutex_lock(&tscs42xx->qos_lock);
 
-	return ret;
+	if (!--tscs42xx->qos_users &&
+	    cpu_latency_qos_request_active(&tscs42xx->qos_req)) {
+		cpu_latency_qos_remove_request(&tscs42xx->qos_req);
+		tscs42xx->qos_stats.held_ns +=
+			ktime_get_ns() - tscs42xx->qos_since_ns;
+	}
+
+	mutex_unlock(&tscs42xx->qos_lock);
 }
 
-/* Input L Capture Route */
-static char const * const input_select_text[] = {
-	"Line 1", "Line 2", "Line 3", "D2S"
-};
+/* Held from hw_params until its unmute reaches the chip or it times out */
+static void qos_stream_get(struct tscs42xx *tscs42xx, int stream)
+{
+	if (!test_and_set_bit(stream, &tscs42xx->qos_streams))
+		qos_get(tscs42xx);
 
-static const struct soc_enum left_input_select_enum =
-SOC_ENUM_SINGLE(R_INSELL, FB_INSELL, ARRAY_SIZE(input_select_text),
-		input_select_text);
+	mod_delayed_work(system_wq, &tscs42xx->qos_timeout,
+		msecs_to_jiffies(QOS_STREAM_HOLD_MS));
+}
 
-static const struct snd_kcontrol_new left_input_select =
-SOC_DAPM_ENUM("LEFT_INPUT_SELECT_ENUM", left_input_select_enum);
+static void qos_stream_put(struct tscs42xx *tscs42xx, int stream)
+{
+	if (test_and_clear_bit(stream, &tscs42xx->qos_streams))
+		qos_put(tscs42xx);
+}
 
-/* Input R Capture Route */
-static const struct soc_enum right_input_select_enum =
-SOC_ENUM_SINGLE(R_INSELR, FB_INSELR, ARRAY_SIZE(input_select_text),
-		input_select_text);
+static void qos_timeout(struct work_struct *work)
+{
+	struct tscs42xx *tscs42xx = container_of(to_delayed_work(work),
+		struct tscs42xx, qos_timeout);
 
-static const struct snd_kcontrol_new right_input_select =
-SOC_DAPM_ENUM("RIGHT_INPUT_SELECT_ENUM", right_input_select_enum);
+	qos_stream_put(tscs42xx, SNDRV_PCM_STREAM_PLAYBACK);
+	qos_stream_put(tscs42xx, SNDRV_PCM_STREAM_CAPTURE);
+}
 
-/* Input Channel Mapping */
-static char const * const ch_map_select_text[] = {
-	"Normal", "Left to Right", "Right to Left", "Swap"
-};
+static void qos_upload_begin(struct tscs42xx *tscs42xx,
+	struct qos_upload *up)
+{
+	qos_get(tscs42xx);
 
-static const struct soc_enum ch_map_select_enum =
-SOC_ENUM_SINGLE(R_AIC2, FB_AIC2_ADCDSEL, ARRAY_SIZE(ch_map_select_text),
-		ch_map_select_text);
+	mutex_lock(&tscs42xx->qos_lock);
+	up->held = cpu_latency_qos_request_active(&tscs42xx->qos_req);
+	mutex_unlock(&tscs42xx->qos_lock);
 
-static int dapm_vref_event(struct snd_soc_dapm_widget *w,
-			 struct snd_kcontrol *kcontrol, int event)
+	up->t0 = ktime_get_ns();
+}
+
+static void qos_upload_end(struct tscs42xx *tscs42xx,
+	const struct qos_upload *up)
 {
-	msleep(20);
-	return 0;
+	u64 dur = ktime_get_ns() - up->t0;
+
+	mutex_lock(&tscs42xx->qos_lock);
+	tscs42xx->qos_stats.uploads[up->held]++;
+	tscs42xx->qos_stats.upload_ns[up->held] += dur;
+	mutex_unlock(&tscs42xx->qos_lock);
+
+	qos_put(tscs42xx);
 }
 
-static int dapm_micb_event(struct snd_soc_dapm_widget *w,
-			 struct snd_kcontrol *kcontrol, int event)
+#ifdef CONFIG_DEBUG_FS
+static int qos_show(struct seq_file *m, void *unused)
 {
-	msleep(20);
+	struct tscs42xx *tscs42xx = m->private;
+	struct tscs42xx_qos_stats st;
+	u64 avg[2] = { 0, 0 };
+	u64 held_ns;
+	int i;
+
+	mutex_lock(&tscs42xx->qos_lock);
+	st = tscs42xx->qos_stats;
+	held_ns = st.held_ns;
+	if (cpu_latency_qos_request_active(&tscs42xx->qos_req))
+		held_ns += ktime_get_ns() - tscs42xx->qos_since_ns;
+	mutex_unlock(&tscs42xx->qos_lock);
+
+	for (i = 0; i < 2; i++)
+		if (st.uploads[i])
+			avg[i] = div_u64(st.upload_ns[i], st.uploads[i]);
+
+	seq_printf(m, "latency_us: %d\n", READ_ONCE(qos_latency_us));
+	seq_printf(m, "holds: %u\n", st.holds);
+	seq_printf(m, "held_us: %llu\n", div_u64(held_ns, NSEC_PER_USEC));
+	seq_printf(m, "uploads: %u plain, %u with qos\n", st.uploads[0],
+		st.uploads[1]);
+	seq_printf(m, "upload_avg_us: %llu plain, %llu with qos\n",
+		div_u64(avg[0], NSEC_PER_USEC), div_u64(avg[1], NSEC_PER_USEC));
+	if (st.uploads[0] && st.uploads[1] && avg[0] > avg[1])
+		seq_printf(m, "saved_us: %llu\n",
+			div_u64((avg[0] - avg[1]) * st.uploads[1],
+				NSEC_PER_USEC));
+
 	return 0;
 }
+DEFINE_SHOW_ATTRIBUTE(qos);
 
-static int pll_event(struct snd_soc_dapm_widget *w,
-		     struct snd_kcontrol *kcontrol, int event)
+static void qos_debugfs_init(struct snd_soc_component *component)
 {
-	struct snd_soc_component *component =
-		snd_soc_dapm_to_component(w->dapm);
-	int ret;
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
 
-	if (SND_SOC_DAPM_EVENT_ON(event))
-		ret = power_up_audio_plls(component);
-	else
-		ret = power_down_audio_plls(component);
+	debugfs_create_file("qos", 0444, component->debugfs_root, tscs42xx,
+		&qos_fops);
+}
+#else
+static inline void qos_debugfs_init(struct snd_soc_component *component)
+{
+}
+#endif
+
+/*
+ * Bus I/O priority
+ *
+ * Codec traffic runs in the context that issues it, so a long coefficient
+ * upload from a tuning tool used to hold up a stream start behind it.
+ * Foreground paths claim a class for their duration: IO_CRITICAL for
+ * hw_params, PLL power and unmute, IO_INTERACTIVE for volume changes.
+ * Background coefficient uploads are split into biquad sized chunks and
+ * each chunk waits until no foreground class is claimed. A foreground
+ * path waits at most for the chunk already on the bus, and interactive
+ * paths also let critical ones go first.
+ *
+ * Chunks stay whole biquads so a preempted upload never leaves a filter
+ * half written for longer than before. debugfs "io" reports the
+ * queueing delay of each class.
+ */
+static const char * const io_class_names[IO_CLASS_CNT] = {
+	[IO_CRITICAL] = "critical",
+	[IO_INTERACTIVE] = "interactive",
+	[IO_BACKGROUND] = "background",
+};
 
-	return ret;
+static void io_init(struct tscs42xx_io *io)
+{
+	spin_lock_init(&io->lock);
+	init_waitqueue_head(&io->wq);
 }
 
-static int dac_event(struct snd_soc_dapm_widget *w,
-		     struct snd_kcontrol *kcontrol, int event)
+static bool io_blocked(struct tscs42xx_io *io, int class)
 {
-	struct snd_soc_component *component =
-		snd_soc_dapm_to_component(w->dapm);
-	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
-	int ret;
+	int i;
 
-	mutex_lock(&tscs42xx->coeff_ram_lock);
+	for (i = 0; i < class; i++)
+		if (io->active[i])
+			return true;
 
-	if (tscs42xx->coeff_ram_synced == false) {
-		ret = write_coeff_ram(component, tscs42xx->coeff_ram, 0x00,
-			COEFF_RAM_COEFF_COUNT);
+	return class != IO_BACKGROUND && io->bg_running;
+}
+
+static bool io_grant(struct tscs42xx_io *io, int class)
+{
+	bool granted;
+
+	spin_lock(&io->lock);
+	granted = !io_blocked(io, class);
+	if (granted && class == IO_BACKGROUND)
+		io->bg_running++;
+	spin_unlock(&io->lock);
+
+	return granted;
+}
+
+static void io_begin(struct tscs42xx *tscs42xx, int class)
+{
+	struct tscs42xx_io *io = &tscs42xx->io;
+	struct io_class_stats *st = &io->stats[class];
+	u64 t0 = ktime_get_ns();
+	bool waited = false;
+	u64 wait;
+
+	if (class != IO_BACKGROUND) {
+		spin_lock(&io->lock);
+		io->active[class]++;
+		spin_unlock(&io->lock);
+	}
+
+	if (!io_grant(io, class)) {
+		wait_event(io->wq, io_grant(io, class));
+		waited = true;
+	}
+	wait = ktime_get_ns() - t0;
+
+	spin_lock(&io->lock);
+	st->grants++;
+	st->wait_ns += wait;
+	st->max_wait_ns = max(st->max_wait_ns, wait);
+	if (waited && class == IO_BACKGROUND)
+		io->bg_yields++;
+	spin_unlock(&io->lock);
+}
+
+static void io_end(struct tscs42xx *tscs42xx, int class)
+{
+	struct tscs42xx_io *io = &tscs42xx->io;
+
+	spin_lock(&io->lock);
+	if (class == IO_BACKGROUND)
+		io->bg_running--;
+	else
+		io->active[class]--;
+	spin_unlock(&io->lock);
+
+	wake_up_all(&io->wq);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int io_show(struct seq_file *m, void *unused)
+{
+	struct tscs42xx *tscs42xx = m->private;
+	struct tscs42xx_io *io = &tscs42xx->io;
+	struct io_class_stats st[IO_CLASS_CNT];
+	unsigned int yields;
+	int i;
+
+	spin_lock(&io->lock);
+	memcpy(st, io->stats, sizeof(st));
+	yields = io->bg_yields;
+	spin_unlock(&io->lock);
+
+	seq_printf(m, "%-12s %8s %12s %12s\n", "class", "grants",
+		"avg_wait_us", "max_wait_us");
+	for (i = 0; i < IO_CLASS_CNT; i++)
+		seq_printf(m, "%-12s %8u %12llu %12llu\n", io_class_names[i],
+			st[i].grants,
+			st[i].grants ? div_u64(div_u64(st[i].wait_ns,
+				st[i].grants), NSEC_PER_USEC) : 0,
+			div_u64(st[i].max_wait_ns, NSEC_PER_USEC));
+	seq_printf(m, "background_yields: %u\n", yields);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(io);
+
+static void io_debugfs_init(struct snd_soc_component *component)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	debugfs_create_file("io", 0444, component->debugfs_root, tscs42xx,
+		&io_fops);
+}
+#else
+static inline void io_debugfs_init(struct snd_soc_component *component)
+{
+}
+#endif
+
+/*
+ * Coefficient RAM
+ *
+ * The DAC coefficient RAM sits behind an indirect interface: DACCRADDR
+ * selects a 24 bit coefficient that then moves through DACCRWR or DACCRRD
+ * once DACCRSTAT reads idle. coeff_regmap exposes it as a regmap of its
+ * own (one register per coefficient) on top of the main one, so cache,
+ * sync, debugfs and tracing come from regmap. Each coefficient is written
+ * as a single multi register write of the address and the three bytes.
+ *
+ * The RAM is only accessible with a PLL locked. Until then the map runs
+ * cache only and coeff_ram_flush() syncs the written range later.
+ */
+#define DACCRSTAT_MAX_TRYS 10
+static int coeff_bus_wait(struct tscs42xx *tscs42xx)
+{
+	unsigned int val;
+	int trys;
+	int ret;
+
+	for (trys = 0; trys < DACCRSTAT_MAX_TRYS; trys++) {
+		ret = regmap_read(tscs42xx->regmap, R_DACCRSTAT, &val);
+		if (ret < 0)
+			return ret;
+		if (!val)
+			return 0;
+	}
+
+	return -EIO;
+}
+
+/* Address byte followed by big endian 24 bit values */
+static int coeff_bus_write(void *context, const void *data, size_t count)
+{
+	struct tscs42xx *tscs42xx = context;
+	const u8 *val = data;
+	unsigned int addr = *val++;
+	int ret;
+
+	for (count--; count >= COEFF_SIZE; count -= COEFF_SIZE, addr++) {
+		struct reg_sequence seq[] = {
+			{ R_DACCRADDR, addr },
+			{ R_DACCRWRL, val[2] },
+			{ R_DACCRWRM, val[1] },
+			{ R_DACCRWRH, val[0] },
+		};
+
+		ret = coeff_bus_wait(tscs42xx);
+		if (ret < 0)
+			return ret;
+
+		ret = regmap_multi_reg_write(tscs42xx->regmap, seq,
+			ARRAY_SIZE(seq));
+		if (ret < 0)
+			return ret;
+
+		val += COEFF_SIZE;
+	}
+
+	return 0;
+}
+
+static int coeff_bus_read(void *context, const void *reg_buf,
+	size_t reg_size, void *val_buf, size_t val_size)
+{
+	struct tscs42xx *tscs42xx = context;
+	unsigned int addr = *(const u8 *)reg_buf;
+	u8 *val = val_buf;
+	u8 rd[COEFF_SIZE];
+	int ret;
+
+	for (; val_size >= COEFF_SIZE; val_size -= COEFF_SIZE, addr++) {
+		ret = coeff_bus_wait(tscs42xx);
+		if (ret < 0)
+			return ret;
+
+		ret = regmap_write(tscs42xx->regmap, R_DACCRADDR, addr);
+		if (ret < 0)
+			return ret;
+
+		ret = coeff_bus_wait(tscs42xx);
+		if (ret < 0)
+			return ret;
+
+		ret = regmap_bulk_read(tscs42xx->regmap, R_DACCRRDL, rd,
+			COEFF_SIZE);
+		if (ret < 0)
+			return ret;
+
+		val[0] = rd[2];
+		val[1] = rd[1];
+		val[2] = rd[0];
+		val += COEFF_SIZE;
+	}
+
+	return 0;
+}
+
+static const struct regmap_bus coeff_bus = {
+	.write = coeff_bus_write,
+	.read = coeff_bus_read,
+};
+
+static const struct regmap_config tscs42xx_coeff_regmap = {
+	.name = "coeff",
+	.reg_bits = 8,
+	.val_bits = 24,
+
+	.max_register = COEFF_RAM_MAX_ADDR,
+
+	.cache_type = REGCACHE_FLAT,
+};
+
+static int sample_rate_to_pll_freq_out(int sample_rate)
+{
+	switch (sample_rate) {
+	case 11025:
+	case 22050:
+	case 44100:
+	case 88200:
+		return 112896000;
+	case 8000:
+	case 16000:
+	case 32000:
+	case 48000:
+	case 96000:
+		return 122880000;
+	default:
+		return -EINVAL;
+	}
+}
+
+/* Lock state of the PLL that runs the current rate family */
+static bool pll_is_locked(struct snd_soc_component *component)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	int ret;
+	unsigned int val;
+	unsigned int mask;
+
+	ret = snd_soc_component_read(component, R_PLLCTL0, &val);
+	if (ret < 0) {
+		dev_err(component->dev,
+			"Failed to read PLL lock status (%d)\n", ret);
+		return false;
+	}
+
+	if (sample_rate_to_pll_freq_out(READ_ONCE(tscs42xx->samplerate)) ==
+	    112896000)
+		mask = RM_PLLCTL0_PLL2_LOCK;
+	else
+		mask = RM_PLLCTL0_PLL1_LOCK;
+
+	return val & mask;
+}
+
+#define MAX_PLL_LOCK_20MS_WAITS 1
+static bool plls_locked(struct snd_soc_component *component)
+{
+	int count = MAX_PLL_LOCK_20MS_WAITS;
+
+	do {
+		if (pll_is_locked(component))
+			return true;
+		msleep(20);
+	} while (count--);
+
+	return false;
+}
+
+/*
+ * Independent register updates are queued with the async regmap API so
+ * bus round trips can overlap. Steps that depend on them (PLL enable and
+ * lock check, coefficient flush) wait here first.
+ */
+static int async_barrier(struct snd_soc_component *component)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	int ret;
+
+	ret = regmap_async_complete(tscs42xx->regmap);
+	if (ret < 0)
+		dev_err(component->dev, "Failed async register write (%d)\n",
+			ret);
+
+	return ret;
+}
+
+static int power_up_audio_plls(struct snd_soc_component *component)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	int freq_out;
+	int ret;
+	unsigned int mask;
+	unsigned int val;
+
+	freq_out = sample_rate_to_pll_freq_out(READ_ONCE(tscs42xx->samplerate));
+	switch (freq_out) {
+	case 122880000: /* 48k */
+		mask = RM_PLLCTL1C_PDB_PLL1;
+		val = RV_PLLCTL1C_PDB_PLL1_ENABLE;
+		break;
+	case 112896000: /* 44.1k */
+		mask = RM_PLLCTL1C_PDB_PLL2;
+		val = RV_PLLCTL1C_PDB_PLL2_ENABLE;
+		break;
+	default:
+		ret = -EINVAL;
+		dev_err(component->dev,
+				"Unrecognized PLL output freq (%d)\n", ret);
+		return ret;
+	}
+
+	/* PLL and sample rate settings must land before the PLL starts */
+	ret = async_barrier(component);
+	if (ret < 0)
+		return ret;
+
+	mutex_lock(&tscs42xx->pll_lock);
+
+	ret = snd_soc_component_update_bits(component, R_PLLCTL1C, mask, val);
+
+	mutex_unlock(&tscs42xx->pll_lock);
+
+	if (ret < 0) {
+		dev_err(component->dev, "Failed to turn PLL on (%d)\n", ret);
+		return ret;
+	}
+
+	/* Wait for lock outside of pll_lock so coefficient writers can bail */
+	if (!plls_locked(component)) {
+		dev_err(component->dev, "Failed to lock plls\n");
+		return -ENOMSG;
+	}
+
+	return 0;
+}
+
+static int power_down_audio_plls(struct snd_soc_component *component)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	int ret;
+
+	mutex_lock(&tscs42xx->pll_lock);
+
+	ret = snd_soc_component_update_bits(component, R_PLLCTL1C,
+			RM_PLLCTL1C_PDB_PLL1 | RM_PLLCTL1C_PDB_PLL2,
+			RV_PLLCTL1C_PDB_PLL1_DISABLE |
+			RV_PLLCTL1C_PDB_PLL2_DISABLE);
+
+	mutex_unlock(&tscs42xx->pll_lock);
+
+	if (ret < 0) {
+		dev_err(component->dev, "Failed to turn PLL off (%d)\n", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+/* Read from the coefficient RAM cache, control byte order */
+static int coeff_ram_read(struct tscs42xx *tscs42xx, unsigned int addr,
+	u8 *data, unsigned int coeff_cnt)
+{
+	unsigned int val;
+	int i;
+	int ret;
+
+	for (i = 0; i < coeff_cnt; i++, data += COEFF_SIZE) {
+		ret = regmap_read(tscs42xx->coeff_regmap, addr + i, &val);
+		if (ret < 0)
+			return ret;
+		data[0] = val & 0xff;
+		data[1] = (val >> 8) & 0xff;
+		data[2] = (val >> 16) & 0xff;
+	}
+
+	return 0;
+}
+
+static int coeff_ram_get(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	struct coeff_ram_ctl *ctl =
+		(struct coeff_ram_ctl *)kcontrol->private_value;
+	struct soc_bytes_ext *params = &ctl->bytes_ext;
+
+	return coeff_ram_read(tscs42xx, ctl->addr, ucontrol->value.bytes.data,
+		params->max / COEFF_SIZE);
+}
+
+static void coeff_ram_mark_dirty(struct tscs42xx *tscs42xx,
+	unsigned int lo, unsigned int hi)
+{
+	if (tscs42xx->coeff_ram_dirty) {
+		lo = min(lo, tscs42xx->coeff_dirty_lo);
+		hi = max(hi, tscs42xx->coeff_dirty_hi);
+	}
+	tscs42xx->coeff_dirty_lo = lo;
+	tscs42xx->coeff_dirty_hi = hi;
+	tscs42xx->coeff_ram_dirty = true;
+}
+
+/* Update the coefficient RAM cache and write it through if possible */
+static int coeff_ram_update(struct snd_soc_component *component,
+	unsigned int addr, const u8 *data, unsigned int coeff_cnt)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	u8 buf[COEFF_BURST_COUNT * COEFF_SIZE];
+	unsigned int done, cnt;
+	bool live;
+	u8 path;
+	int ret = 0;
+	int i;
+
+	mutex_lock(&tscs42xx->coeff_ram_lock);
+
+	/*
+	 * Do not wait for the PLL here. If it is not locked the write only
+	 * lands in the cache and the DAC power up event syncs it once it is.
+	 */
+	mutex_lock(&tscs42xx->pll_lock);
+
+	live = pll_is_locked(component);
+	regcache_cache_only(tscs42xx->coeff_regmap, !live);
+
+	path = journal_path_push(tscs42xx, JOURNAL_PATH_COEFF);
+	for (done = 0; done < coeff_cnt; done += cnt) {
+		cnt = min_t(unsigned int, coeff_cnt - done, COEFF_BURST_COUNT);
+
+		/* Controls are little endian, 24 bit regmap values big endian */
+		for (i = 0; i < cnt * COEFF_SIZE; i += COEFF_SIZE) {
+			buf[i] = data[i + 2];
+			buf[i + 1] = data[i + 1];
+			buf[i + 2] = data[i];
+		}
+
+		ret = regmap_raw_write(tscs42xx->coeff_regmap, addr + done,
+			buf, cnt * COEFF_SIZE);
+		if (ret < 0)
+			break;
+		data += cnt * COEFF_SIZE;
+	}
+	journal_path_pop(tscs42xx, path);
+	if (ret < 0)
+		dev_err(component->dev,
+			"Failed to write coeff ram (%d)\n", ret);
+
+	if (!live || ret < 0)
+		coeff_ram_mark_dirty(tscs42xx, addr, addr + coeff_cnt - 1);
+
+	mutex_unlock(&tscs42xx->pll_lock);
+
+	mutex_unlock(&tscs42xx->coeff_ram_lock);
+
+	return ret;
+}
+
+/* Coefficient upload that yields to foreground I/O between biquads */
+static int coeff_ram_update_bg(struct snd_soc_component *component,
+	unsigned int addr, const u8 *data, unsigned int coeff_cnt)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	unsigned int cnt;
+	int ret = 0;
+
+	while (coeff_cnt) {
+		cnt = min_t(unsigned int, coeff_cnt, BIQUAD_COEFF_COUNT);
+
+		io_begin(tscs42xx, IO_BACKGROUND);
+		ret = coeff_ram_update(component, addr, data, cnt);
+		io_end(tscs42xx, IO_BACKGROUND);
+		if (ret < 0)
+			break;
+
+		addr += cnt;
+		data += cnt * COEFF_SIZE;
+		coeff_cnt -= cnt;
+	}
+
+	return ret;
+}
+
+/*
+ * Loudness compensation
+ *
+ * When enabled the driver owns Cascade2 BiQuad5 (bass low shelf at 100 Hz)
+ * and BiQuad6 (treble high shelf at 10 kHz) on both channels, so EQ2 must
+ * run with "Band1:6". Enabling is refused while those biquads hold
+ * anything but pass through, and while enabled their controls return
+ * -EBUSY and profiles leave them alone. The shelves are boosted as the
+ * combined DAC and output attenuation grows, one table step per 6 dB.
+ *
+ * The tables are generated per rate by "tscs42xx-coeffc -l" and share its
+ * biquad sign convention (tools/tscs42xx/coeff.h), so a correction there
+ * is picked up by regenerating them. Below 25 kHz the treble corner is
+ * too close to Nyquist and that shelf stays at pass through.
+ */
+#define LOUDNESS_STEPS 9
+#define LOUDNESS_STEP_CDB 600
+#define LOUDNESS_UPDATE_MS 50
+
+static const unsigned int loudness_addrs[][2] = {
+	{ 0x54, 0x74 },	/* Bass, L and R */
+	{ 0x59, 0x79 },	/* Treble, L and R */
+};
+
+/* 2.22 coefficients b0 b1 b2 a1 a2, bass then treble */
+static const struct loudness_table {
+	unsigned int rate;
+	u32 coeffs[LOUDNESS_STEPS][2 * BIQUAD_COEFF_COUNT];
+} loudness_tables[] = {
+	{
+		.rate = 8000,
+		.coeffs = {
+			/* 0 dB: bass +0.0 dB, treble off */
+			{
+				0x400000, 0x871a15, 0x39459f, 0x871a15, 0x39459f,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -6 dB: bass +1.5 dB, treble off */
+			{
+				0x404eb5, 0x86d5c2, 0x39441e, 0x86cd77, 0x398a87,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -12 dB: bass +3.0 dB, treble off */
+			{
+				0x409def, 0x8694bf, 0x393f96, 0x86840f, 0x39ccd6,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -18 dB: bass +4.5 dB, treble off */
+			{
+				0x40edd7, 0x8656fa, 0x393806, 0x863dbc, 0x3a0ca0,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -24 dB: bass +6.0 dB, treble off */
+			{
+				0x413e93, 0x861c61, 0x392d6d, 0x85fa5d, 0x3a49fd,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -30 dB: bass +7.5 dB, treble off */
+			{
+				0x41904c, 0x85e4e6, 0x391fc7, 0x85b9d3, 0x3a84ff,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -36 dB: bass +9.0 dB, treble off */
+			{
+				0x41e32b, 0x85b07c, 0x390f10, 0x857bff, 0x3abdbd,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -42 dB: bass +10.5 dB, treble off */
+			{
+				0x42375c, 0x857f18, 0x38fb42, 0x8540c4, 0x3af44a,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -48 dB: bass +12.0 dB, treble off */
+			{
+				0x428d09, 0x8550b0, 0x38e45a, 0x850807, 0x3b28b9,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+		},
+	},
+	{
+		.rate = 11025,
+		.coeffs = {
+			/* 0 dB: bass +0.0 dB, treble off */
+			{
+				0x400000, 0x8527d2, 0x3b0b52, 0x8527d2, 0x3b0b52,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -6 dB: bass +1.5 dB, treble off */
+			{
+				0x403919, 0x84f48f, 0x3b0a30, 0x84f022, 0x3b3edb,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -12 dB: bass +3.0 dB, treble off */
+			{
+				0x407280, 0x84c3b1, 0x3b06ca, 0x84bac9, 0x3b7063,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -18 dB: bass +4.5 dB, treble off */
+			{
+				0x40ac52, 0x849526, 0x3b011e, 0x8487b0, 0x3b9ffa,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -24 dB: bass +6.0 dB, treble off */
+			{
+				0x40e6a9, 0x8468df, 0x3af92b, 0x8456bd, 0x3bcdb2,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -30 dB: bass +7.5 dB, treble off */
+			{
+				0x4121a4, 0x843ece, 0x3aeeed, 0x8427db, 0x3bf99e,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -36 dB: bass +9.0 dB, treble off */
+			{
+				0x415d5f, 0x8416e5, 0x3ae261, 0x83faf1, 0x3c23cd,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -42 dB: bass +10.5 dB, treble off */
+			{
+				0x4199fa, 0x83f119, 0x3ad383, 0x83cfed, 0x3c4c50,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -48 dB: bass +12.0 dB, treble off */
+			{
+				0x41d791, 0x83cd60, 0x3ac24d, 0x83a6b9, 0x3c7337,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+		},
+	},
+	{
+		.rate = 16000,
+		.coeffs = {
+			/* 0 dB: bass +0.0 dB, treble off */
+			{
+				0x400000, 0x838dae, 0x3c8ae7, 0x838dae, 0x3c8ae7,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -6 dB: bass +1.5 dB, treble off */
+			{
+				0x402755, 0x836965, 0x3c8a1a, 0x836744, 0x3caf4f,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -12 dB: bass +3.0 dB, treble off */
+			{
+				0x404ed6, 0x8346c0, 0x3c87b2, 0x83427a, 0x3cd241,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -18 dB: bass +4.5 dB, treble off */
+			{
+				0x407694, 0x8325b2, 0x3c83af, 0x831f3c, 0x3cf3cd,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -24 dB: bass +6.0 dB, treble off */
+			{
+				0x409ea3, 0x83062e, 0x3c7e0e, 0x82fd7b, 0x3d13ff,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -30 dB: bass +7.5 dB, treble off */
+			{
+				0x40c718, 0x82e828, 0x3c76ce, 0x82dd27, 0x3d32e5,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -36 dB: bass +9.0 dB, treble off */
+			{
+				0x40f005, 0x82cb96, 0x3c6dec, 0x82be30, 0x3d508c,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -42 dB: bass +10.5 dB, treble off */
+			{
+				0x411980, 0x82b06c, 0x3c6364, 0x82a087, 0x3d6d00,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -48 dB: bass +12.0 dB, treble off */
+			{
+				0x41439c, 0x8296a2, 0x3c5733, 0x82841f, 0x3d884c,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+		},
+	},
+	{
+		.rate = 22050,
+		.coeffs = {
+			/* 0 dB: bass +0.0 dB, treble off */
+			{
+				0x400000, 0x829429, 0x3d78e1, 0x829429, 0x3d78e1,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -6 dB: bass +1.5 dB, treble off */
+			{
+				0x401c89, 0x827967, 0x3d784a, 0x827846, 0x3d93b2,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -12 dB: bass +3.0 dB, treble off */
+			{
+				0x40392c, 0x825fd6, 0x3d7684, 0x825d91, 0x3dad6c,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -18 dB: bass +4.5 dB, treble off */
+			{
+				0x4055f8, 0x824769, 0x3d738f, 0x8243fd, 0x3dc61a,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -24 dB: bass +6.0 dB, treble off */
+			{
+				0x4072f9, 0x823019, 0x3d6f69, 0x822b7d, 0x3dddc6,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -30 dB: bass +7.5 dB, treble off */
+			{
+				0x40903f, 0x8219da, 0x3d6a10, 0x821406, 0x3df47b,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -36 dB: bass +9.0 dB, treble off */
+			{
+				0x40add7, 0x8204a4, 0x3d6383, 0x81fd8c, 0x3e0a42,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -42 dB: bass +10.5 dB, treble off */
+			{
+				0x40cbd0, 0x81f06f, 0x3d5bbe, 0x81e805, 0x3e1f24,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+			/* -48 dB: bass +12.0 dB, treble off */
+			{
+				0x40ea39, 0x81dd34, 0x3d52bf, 0x81d367, 0x3e332c,
+				0x400000, 0x000000, 0x000000, 0x000000, 0x000000,
+			},
+		},
+	},
+	{
+		.rate = 32000,
+		.coeffs = {
+			/* 0 dB: bass +0.0 dB, treble +0.0 dB */
+			{
+				0x400000, 0x81c6ec, 0x3e3f4f, 0x81c6ec, 0x3e3f4f,
+				0x400000, 0x1da0c7, 0x0d6bfa, 0x1da0c7, 0x0d6bfa,
+			},
+			/* -6 dB: bass +1.5 dB, treble +0.5 dB */
+			{
+				0x4013a9, 0x81b43e, 0x3e3ee5, 0x81b3b4, 0x3e5204,
+				0x416e75, 0x1d4014, 0x0d8d6b, 0x1ea42f, 0x0d97c6,
+			},
+			/* -12 dB: bass +3.0 dB, treble +1.0 dB */
+			{
+				0x402761, 0x81a261, 0x3e3da8, 0x81a14c, 0x3e63f4,
+				0x42e520, 0x1cd625, 0x0db00e, 0x1fa672, 0x0dc4e1,
+			},
+			/* -18 dB: bass +4.5 dB, treble +1.5 dB */
+			{
+				0x403b31, 0x81914d, 0x3e3b98, 0x818faa, 0x3e7527,
+				0x446436, 0x1c629e, 0x0dd3fc, 0x20a788, 0x0df348,
+			},
+			/* -24 dB: bass +6.0 dB, treble +2.0 dB */
+			{
+				0x404f25, 0x8180fb, 0x3e38b2, 0x817ec8, 0x3e85a4,
+				0x45ebeb, 0x1be526, 0x0df94c, 0x21a769, 0x0e22f4,
+			},
+			/* -30 dB: bass +7.5 dB, treble +2.5 dB */
+			{
+				0x406344, 0x817164, 0x3e34f7, 0x816e9c, 0x3e9573,
+				0x477c75, 0x1b5d5e, 0x0e201b, 0x22a60e, 0x0e53e0,
+			},
+			/* -36 dB: bass +9.0 dB, treble +3.0 dB */
+			{
+				0x407799, 0x816281, 0x3e3064, 0x815f1e, 0x3ea49b,
+				0x49160d, 0x1acae5, 0x0e4882, 0x23a36f, 0x0e8605,
+			},
+			/* -42 dB: bass +10.5 dB, treble +3.5 dB */
+			{
+				0x408c2e, 0x81544c, 0x3e2af7, 0x815049, 0x3eb322,
+				0x4ab8ed, 0x1a2d57, 0x0e729e, 0x249f84, 0x0eb95e,
+			},
+			/* -48 dB: bass +12.0 dB, treble +4.0 dB */
+			{
+				0x40a10d, 0x8146c0, 0x3e24ae, 0x814213, 0x3ec10f,
+				0x4c6550, 0x19844d, 0x0e9e8f, 0x259a47, 0x0eede5,
+			},
+		},
+	},
+	{
+		.rate = 44100,
+		.coeffs = {
+			/* 0 dB: bass +0.0 dB, treble +0.0 dB */
+			{
+				0x400000, 0x814a1d, 0x3eb92e, 0x814a1d, 0x3eb92e,
+				0x400000, 0xf50a62, 0x0b500f, 0xf50a62, 0x0b500f,
+			},
+			/* -6 dB: bass +1.5 dB, treble +0.5 dB */
+			{
+				0x400e43, 0x813c73, 0x3eb8e1, 0x813c2a, 0x3ec6db,
+				0x420807, 0xf396dc, 0x0bbdf4, 0xf61c99, 0x0b403e,
+			},
+			/* -12 dB: bass +3.0 dB, treble +1.0 dB */
+			{
+				0x401c91, 0x812f61, 0x3eb7f9, 0x812ece, 0x3ed3f7,
+				0x44208d, 0xf20f18, 0x0c3199, 0xf72f35, 0x0b3209,
+			},
+			/* -18 dB: bass +4.5 dB, treble +1.5 dB */
+			{
+				0x402aef, 0x8122e0, 0x3eb677, 0x812203, 0x3ee088,
+				0x464a18, 0xf0723b, 0x0cab4b, 0xf8422c, 0x0b2572,
+			},
+			/* -24 dB: bass +6.0 dB, treble +2.0 dB */
+			{
+				0x403964, 0x8116ec, 0x3eb458, 0x8115c2, 0x3eec93,
+				0x48852e, 0xeebf65, 0x0d2b5a, 0xf95571, 0x0b1a7c,
+			},
+			/* -30 dB: bass +7.5 dB, treble +2.5 dB */
+			{
+				0x4047f9, 0x810b7e, 0x3eb19e, 0x810a06, 0x3ef81f,
+				0x4ad25e, 0xecf5ad, 0x0db217, 0xfa68fb, 0x0b1126,
+			},
+			/* -36 dB: bass +9.0 dB, treble +3.0 dB */
+			{
+				0x4056b3, 0x810092, 0x3eae45, 0x80fec8, 0x3f032f,
+				0x4d3236, 0xeb1424, 0x0e3fd9, 0xfb7cbe, 0x0b0974,
+			},
+			/* -42 dB: bass +10.5 dB, treble +3.5 dB */
+			{
+				0x40659a, 0x80f623, 0x3eaa4d, 0x80f405, 0x3f0dc9,
+				0x4fa54c, 0xe919cf, 0x0ed4f9, 0xfc90b0, 0x0b0365,
+			},
+			/* -48 dB: bass +12.0 dB, treble +4.0 dB */
+			{
+				0x4074b6, 0x80ec2d, 0x3ea5b4, 0x80e9b5, 0x3f17f3,
+				0x522c3a, 0xe705ae, 0x0f71d7, 0xfda4c5, 0x0afefa,
+			},
+		},
+	},
+	{
+		.rate = 48000,
+		.coeffs = {
+			/* 0 dB: bass +0.0 dB, treble +0.0 dB */
+			{
+				0x400000, 0x812f4b, 0x3ed37d, 0x812f4b, 0x3ed37d,
+				0x400000, 0xec50d5, 0x0c0dd9, 0xec50d5, 0x0c0dd9,
+			},
+			/* -6 dB: bass +1.5 dB, treble +0.5 dB */
+			{
+				0x400d1a, 0x8122b8, 0x3ed336, 0x81227a, 0x3ee013,
+				0x422939, 0xea90f5, 0x0c953e, 0xed5e40, 0x0bf12c,
+			},
+			/* -12 dB: bass +3.0 dB, treble +1.0 dB */
+			{
+				0x401a3e, 0x8116b0, 0x3ed261, 0x811634, 0x3eec23,
+				0x44651d, 0xe8b972, 0x0d23db, 0xee6c66, 0x0bd605,
+			},
+			/* -18 dB: bass +4.5 dB, treble +1.5 dB */
+			{
+				0x402771, 0x810b2e, 0x3ed0fd, 0x810a73, 0x3ef7b3,
+				0x46b44a, 0xe6c94a, 0x0dba0e, 0xef7b3c, 0x0bbc66,
+			},
+			/* -24 dB: bass +6.0 dB, treble +2.0 dB */
+			{
+				0x4034b9, 0x81002c, 0x3ecf0a, 0x80ff31, 0x3f02c8,
+				0x491763, 0xe4bf71, 0x0e5837, 0xf08ab8, 0x0ba453,
+			},
+			/* -30 dB: bass +7.5 dB, treble +2.5 dB */
+			{
+				0x40421d, 0x80f5a6, 0x3ecc87, 0x80f469, 0x3f0d66,
+				0x4b8f11, 0xe29ad1, 0x0efebf, 0xf19ad1, 0x0b8dd0,
+			},
+			/* -36 dB: bass +9.0 dB, treble +3.0 dB */
+			{
+				0x404fa4, 0x80eb98, 0x3ec973, 0x80ea15, 0x3f1794,
+				0x4e1c00, 0xe05a4b, 0x0fae0e, 0xf2ab7b, 0x0b78de,
+			},
+			/* -42 dB: bass +10.5 dB, treble +3.5 dB */
+			{
+				0x405d53, 0x80e1fb, 0x3ec5cc, 0x80e031, 0x3f2155,
+				0x50bee5, 0xddfcb4, 0x106696, 0xf3bcac, 0x0b6582,
+			},
+			/* -48 dB: bass +12.0 dB, treble +4.0 dB */
+			{
+				0x406b32, 0x80d8cd, 0x3ec191, 0x80d6b8, 0x3f2aae,
+				0x537877, 0xdb80d7, 0x1128c9, 0xf4ce5a, 0x0b53bd,
+			},
+		},
+	},
+	{
+		.rate = 88200,
+		.coeffs = {
+			/* 0 dB: bass +0.0 dB, treble +0.0 dB */
+			{
+				0x400000, 0x80a50f, 0x3f5bc4, 0x80a50f, 0x3f5bc4,
+				0x400000, 0xbdbfc1, 0x178a36, 0xbdbfc1, 0x178a36,
+			},
+			/* -6 dB: bass +1.5 dB, treble +0.5 dB */
+			{
+				0x400721, 0x809e28, 0x3f5b9d, 0x809e16, 0x3f62ac,
+				0x42db81, 0xb9fe89, 0x18e806, 0xbe84d7, 0x173d39,
+			},
+			/* -12 dB: bass +3.0 dB, treble +1.0 dB */
+			{
+				0x400e47, 0x80978d, 0x3f5b28, 0x809768, 0x3f694a,
+				0x45d7a3, 0xb60b4d, 0x1a595e, 0xbf4bbb, 0x16f093,
+			},
+			/* -18 dB: bass +4.5 dB, treble +1.5 dB */
+			{
+				0x401574, 0x80913a, 0x3f5a65, 0x809102, 0x3f6fa1,
+				0x48f5d3, 0xb1e3a1, 0x1bdf45, 0xc0146e, 0x16a44b,
+			},
+			/* -24 dB: bass +6.0 dB, treble +2.0 dB */
+			{
+				0x401cac, 0x808b2c, 0x3f5953, 0x808ae2, 0x3f75b4,
+				0x4c378e, 0xad84fb, 0x1d7acd, 0xc0deef, 0x165867,
+			},
+			/* -30 dB: bass +7.5 dB, treble +2.5 dB */
+			{
+				0x4023f3, 0x808562, 0x3f57f2, 0x808503, 0x3f7b86,
+				0x4f9e5e, 0xa8ecb6, 0x1f2d15, 0xc1ab3c, 0x160cee,
+			},
+			/* -36 dB: bass +9.0 dB, treble +3.0 dB */
+			{
+				0x402b4b, 0x807fd7, 0x3f5641, 0x807f65, 0x3f811a,
+				0x532be1, 0xa4180d, 0x20f74a, 0xc27954, 0x15c1e5,
+			},
+			/* -42 dB: bass +10.5 dB, treble +3.5 dB */
+			{
+				0x4032ba, 0x807a8b, 0x3f5440, 0x807a03, 0x3f8671,
+				0x56e1c3, 0x9f041d, 0x22daa8, 0xc34935, 0x157753,
+			},
+			/* -48 dB: bass +12.0 dB, treble +4.0 dB */
+			{
+				0x403a41, 0x807579, 0x3f51ed, 0x8074db, 0x3f8b90,
+				0x5ac1c4, 0x99ade0, 0x24d87a, 0xc41ade, 0x152d3f,
+			},
+		},
+	},
+	{
+		.rate = 96000,
+		.coeffs = {
+			/* 0 dB: bass +0.0 dB, treble +0.0 dB */
+			{
+				0x400000, 0x8097a6, 0x3f690d, 0x8097a6, 0x3f690d,
+				0x400000, 0xb90265, 0x197b54, 0xb90265, 0x197b54,
+			},
+			/* -6 dB: bass +1.5 dB, treble +0.5 dB */
+			{
+				0x40068d, 0x80914d, 0x3f68e9, 0x80913e, 0x3f6f66,
+				0x42edc1, 0xb502a3, 0x1af83c, 0xb9bbea, 0x192cb7,
+			},
+			/* -12 dB: bass +3.0 dB, treble +1.0 dB */
+			{
+				0x400d1e, 0x808b3a, 0x3f687d, 0x808b1b, 0x3f757c,
+				0x45fdca, 0xb0cd42, 0x1c8a7e, 0xba773f, 0x18de4b,
+			},
+			/* -18 dB: bass +4.5 dB, treble +1.5 dB */
+			{
+				0x4013b5, 0x808569, 0x3f67ca, 0x80853a, 0x3f7b50,
+				0x4931a4, 0xac5f9c, 0x1e333b, 0xbb3465, 0x189017,
+			},
+			/* -24 dB: bass +6.0 dB, treble +2.0 dB */
+			{
+				0x401a57, 0x807fd8, 0x3f66ce, 0x807f99, 0x3f80e6,
+				0x4c8ae9, 0xa7b6f0, 0x1ff3a2, 0xbbf35c, 0x18421f,
+			},
+			/* -30 dB: bass +7.5 dB, treble +2.5 dB */
+			{
+				0x402106, 0x807a84, 0x3f6589, 0x807a35, 0x3f8640,
+				0x500b46, 0xa2d05b, 0x21ccee, 0xbcb423, 0x17f46b,
+			},
+			/* -36 dB: bass +9.0 dB, treble +3.0 dB */
+			{
+				0x4027c6, 0x80756c, 0x3f63fb, 0x80750b, 0x3f8b60,
+				0x53b478, 0x9da8d7, 0x23c06d, 0xbd76bc, 0x17a700,
+			},
+			/* -42 dB: bass +10.5 dB, treble +3.5 dB */
+			{
+				0x402e99, 0x80708c, 0x3f6223, 0x807019, 0x3f9049,
+				0x578850, 0x983d3c, 0x25cf7c, 0xbe3b24, 0x1759e4,
+			},
+			/* -48 dB: bass +12.0 dB, treble +4.0 dB */
+			{
+				0x403583, 0x806be2, 0x3f6000, 0x806b5c, 0x3f94fe,
+				0x5b88b4, 0x928a3e, 0x27fb87, 0xbf015c, 0x170d1d,
+			},
+		},
+	},
+};
+
+static const u32 *loudness_coeffs(unsigned int rate, int step)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(loudness_tables); i++)
+		if (loudness_tables[i].rate == rate)
+			return loudness_tables[i].coeffs[step];
+
+	return NULL;
+}
+
+/* Whether a coefficient range overlaps the shelves while loudness is on */
+static bool loudness_owns(struct tscs42xx *tscs42xx, unsigned int addr,
+	unsigned int count)
+{
+	unsigned int base;
+	int i, ch;
+
+	if (!READ_ONCE(tscs42xx->loudness_en))
+		return false;
+
+	for (i = 0; i < ARRAY_SIZE(loudness_addrs); i++) {
+		for (ch = 0; ch < 2; ch++) {
+			base = loudness_addrs[i][ch];
+			if (addr < base + BIQUAD_COEFF_COUNT &&
+			    base < addr + count)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Table step for the attenuation, using the volume TLV scales in 0.01 dB,
+ * or a negative error code
+ */
+static int loudness_step(struct snd_soc_component *component)
+{
+	static const unsigned int regs[] = {
+		R_DACVOLL, R_DACVOLR, R_HPVOLL, R_HPVOLR, R_SPKVOLL, R_SPKVOLR,
+	};
+	unsigned int vol[ARRAY_SIZE(regs)];
+	int dac, out, atten;
+	int ret;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(regs); i++) {
+		ret = snd_soc_component_read(component, regs[i], &vol[i]);
+		if (ret < 0)
+			return ret;
+	}
+
+	dac = -9563 + 38 * (int)max(vol[0], vol[1]);
+	out = max(-8850 + 75 * (int)max(vol[2], vol[3]),
+		-7725 + 75 * (int)max(vol[4], vol[5]));
+	atten = -(min(dac, 0) + min(out, 0));
+
+	return clamp(atten / LOUDNESS_STEP_CDB, 0, LOUDNESS_STEPS - 1);
+}
+
+static void loudness_biquad(const u32 *coeffs, u8 *buf)
+{
+	int j;
+
+	for (j = 0; j < BIQUAD_COEFF_COUNT; j++) {
+		/* No table restores the shelf to pass through */
+		u32 c = coeffs ? coeffs[j] : (j ? 0 : 0x400000);
+
+		buf[j * COEFF_SIZE] = c & 0xff;
+		buf[j * COEFF_SIZE + 1] = (c >> 8) & 0xff;
+		buf[j * COEFF_SIZE + 2] = (c >> 16) & 0xff;
+	}
+}
+
+static int loudness_apply(struct tscs42xx *tscs42xx, const u32 *coeffs)
+{
+	struct snd_soc_component *component = tscs42xx->component;
+	u8 cur[BIQUAD_SIZE];
+	u8 new[BIQUAD_SIZE];
+	int i, ch;
+	int ret;
+
+	for (i = 0; i < ARRAY_SIZE(loudness_addrs); i++) {
+		loudness_biquad(coeffs ? &coeffs[i * BIQUAD_COEFF_COUNT] : NULL,
+			new);
+
+		/* Only flush biquads that actually changed */
+		for (ch = 0; ch < 2; ch++) {
+			if (!coeff_ram_read(tscs42xx, loudness_addrs[i][ch],
+					cur, BIQUAD_COEFF_COUNT) &&
+			    !memcmp(cur, new, BIQUAD_SIZE))
+				continue;
+			ret = coeff_ram_update_bg(component,
+				loudness_addrs[i][ch], new, BIQUAD_COEFF_COUNT);
+			if (ret < 0) {
+				dev_err(component->dev,
+					"Failed to update loudness shelf (%d)\n",
+					ret);
+				return ret;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/* User or profile data in the shelf biquads that enabling would overwrite */
+static bool loudness_busy(struct tscs42xx *tscs42xx)
+{
+	u8 cur[BIQUAD_SIZE];
+	u8 thru[BIQUAD_SIZE];
+	int i, ch;
+
+	loudness_biquad(NULL, thru);
+	for (i = 0; i < ARRAY_SIZE(loudness_addrs); i++) {
+		for (ch = 0; ch < 2; ch++) {
+			if (coeff_ram_read(tscs42xx, loudness_addrs[i][ch],
+					cur, BIQUAD_COEFF_COUNT) < 0 ||
+			    memcmp(cur, thru, BIQUAD_SIZE))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+static void loudness_work(struct work_struct *work)
+{
+	struct tscs42xx *tscs42xx = container_of(to_delayed_work(work),
+		struct tscs42xx, loudness_work);
+	struct snd_soc_component *component = tscs42xx->component;
+	const u32 *coeffs;
+	int step;
+
+	mutex_lock(&tscs42xx->loudness_lock);
+
+	if (!tscs42xx->loudness_en)
+		goto exit;
+
+	/* The shelves keep their previous step if the volume can't be read */
+	step = loudness_step(component);
+	if (step < 0) {
+		dev_err(component->dev, "Failed to read volumes (%d)\n", step);
+		goto exit;
+	}
+
+	/* Nothing to do until a rate is set, hw_params reschedules */
+	coeffs = loudness_coeffs(READ_ONCE(tscs42xx->samplerate), step);
+	if (coeffs)
+		loudness_apply(tscs42xx, coeffs);
+exit:
+	mutex_unlock(&tscs42xx->loudness_lock);
+}
+
+static inline void loudness_schedule(struct tscs42xx *tscs42xx)
+{
+	/* Coalesces updates while a slider is being dragged */
+	if (READ_ONCE(tscs42xx->loudness_en))
+		schedule_delayed_work(&tscs42xx->loudness_work,
+			msecs_to_jiffies(LOUDNESS_UPDATE_MS));
+}
+
+static int loudness_get(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	ucontrol->value.integer.value[0] = READ_ONCE(tscs42xx->loudness_en);
+
+	return 0;
+}
+
+static int loudness_put(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	bool en = !!ucontrol->value.integer.value[0];
+	int ret = 0;
+
+	mutex_lock(&tscs42xx->loudness_lock);
+
+	if (tscs42xx->loudness_en == en)
+		goto exit;
+
+	if (en) {
+		if (loudness_busy(tscs42xx)) {
+			dev_dbg(component->dev,
+				"Cascade2 BiQuad5/6 in use, loudness refused\n");
+			ret = -EBUSY;
+			goto exit;
+		}
+		WRITE_ONCE(tscs42xx->loudness_en, true);
+		mod_delayed_work(system_wq, &tscs42xx->loudness_work, 0);
+		ret = 1;
+		goto exit;
+	}
+
+	/* Hand the biquads back at pass through before anyone can write them */
+	ret = loudness_apply(tscs42xx, NULL);
+	WRITE_ONCE(tscs42xx->loudness_en, false);
+	if (ret == 0)
+		ret = 1;
+exit:
+	mutex_unlock(&tscs42xx->loudness_lock);
+
+	return ret;
+}
+
+/*
+ * Grouped instances
+ *
+ * Boards with several codecs on separate I2C buses can give them the
+ * same "tempo,group-id". A coefficient write to any member is queued to
+ * every probed member on the unbound workqueue, so the uploads run
+ * concurrently on their buses and the write returns once all are done.
+ *
+ * The group lock is held until every member has finished, so a write to
+ * the group takes as long as the slowest member's bus, and other writes to
+ * the same group queue behind it. Groups of independent codecs therefore
+ * belong on buses that are equally fast and healthy.
+ *
+ * A write that touches biquads loudness compensation owns on any member
+ * fails with -EBUSY before anything is queued, as it does on one codec.
+ */
+struct tscs42xx_group {
+	struct list_head node;		/* in tscs42xx_group_list */
+	u32 id;
+	struct mutex lock;		/* members, their component and jobs */
+	struct list_head members;
+};
+
+static LIST_HEAD(tscs42xx_group_list);
+static DEFINE_MUTEX(tscs42xx_group_lock);
+
+static void group_job_work(struct work_struct *work)
+{
+	struct tscs42xx_group_job *job =
+		container_of(work, struct tscs42xx_group_job, work);
+	struct tscs42xx *tscs42xx =
+		container_of(job, struct tscs42xx, group_job);
+
+	/* Loudness may have been enabled since the check */
+	if (loudness_owns(tscs42xx, job->addr, job->coeff_cnt)) {
+		job->ret = -EBUSY;
+		return;
+	}
+
+	job->ret = coeff_ram_update_bg(tscs42xx->component, job->addr,
+		job->data, job->coeff_cnt);
+}
+
+static int group_coeff_ram_update(struct tscs42xx *tscs42xx,
+	unsigned int addr, const u8 *data, unsigned int coeff_cnt)
+{
+	struct tscs42xx_group *group = tscs42xx->group;
+	struct tscs42xx *member;
+	int ret = 0;
+
+	mutex_lock(&group->lock);
+
+	list_for_each_entry(member, &group->members, group_node) {
+		if (member->component &&
+		    loudness_owns(member, addr, coeff_cnt)) {
+			ret = -EBUSY;
+			goto exit;
+		}
+	}
+
+	list_for_each_entry(member, &group->members, group_node) {
+		if (!member->component)
+			continue;
+		member->group_job.addr = addr;
+		member->group_job.coeff_cnt = coeff_cnt;
+		memcpy(member->group_job.data, data, coeff_cnt * COEFF_SIZE);
+		queue_work(system_unbound_wq, &member->group_job.work);
+	}
+
+	list_for_each_entry(member, &group->members, group_node) {
+		if (!member->component)
+			continue;
+		flush_work(&member->group_job.work);
+		if (member->group_job.ret < 0) {
+			dev_err(member->component->dev,
+				"Failed group coefficient write (%d)\n",
+				member->group_job.ret);
+			ret = member->group_job.ret;
+		}
+	}
+exit:
+	mutex_unlock(&group->lock);
+
+	return ret;
+}
+
+/* Waits for a fan out of the own group that may still use the component */
+static void group_attach(struct tscs42xx *tscs42xx,
+	struct snd_soc_component *component)
+{
+	struct tscs42xx_group *group = tscs42xx->group;
+
+	if (!group) {
+		tscs42xx->component = component;
+		return;
+	}
+
+	mutex_lock(&group->lock);
+	tscs42xx->component = component;
+	mutex_unlock(&group->lock);
+}
+
+static void group_unlink(void *data)
+{
+	struct tscs42xx *tscs42xx = data;
+	struct tscs42xx_group *group = tscs42xx->group;
+	bool empty;
+
+	mutex_lock(&tscs42xx_group_lock);
+
+	mutex_lock(&group->lock);
+	list_del(&tscs42xx->group_node);
+	empty = list_empty(&group->members);
+	mutex_unlock(&group->lock);
+
+	if (empty) {
+		list_del(&group->node);
+		kfree(group);
+	}
+
+	mutex_unlock(&tscs42xx_group_lock);
+}
+
+static int group_link(struct device *dev, struct tscs42xx *tscs42xx)
+{
+	struct tscs42xx_group *group;
+	u32 id;
+
+	INIT_WORK(&tscs42xx->group_job.work, group_job_work);
+	INIT_LIST_HEAD(&tscs42xx->group_node);
+
+	if (device_property_read_u32(dev, "tempo,group-id", &id))
+		return 0;
+
+	mutex_lock(&tscs42xx_group_lock);
+
+	list_for_each_entry(group, &tscs42xx_group_list, node)
+		if (group->id == id)
+			goto found;
+
+	group = kzalloc(sizeof(*group), GFP_KERNEL);
+	if (!group) {
+		mutex_unlock(&tscs42xx_group_lock);
+		return -ENOMEM;
+	}
+	group->id = id;
+	mutex_init(&group->lock);
+	INIT_LIST_HEAD(&group->members);
+	list_add_tail(&group->node, &tscs42xx_group_list);
+found:
+	mutex_lock(&group->lock);
+	list_add_tail(&tscs42xx->group_node, &group->members);
+	mutex_unlock(&group->lock);
+	tscs42xx->group = group;
+
+	mutex_unlock(&tscs42xx_group_lock);
+
+	return devm_add_action_or_reset(dev, group_unlink, tscs42xx);
+}
+
+static int coeff_ram_put(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct coeff_ram_ctl *ctl =
+		(struct coeff_ram_ctl *)kcontrol->private_value;
+	struct soc_bytes_ext *params = &ctl->bytes_ext;
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	struct coeff_sched *sched = &tscs42xx->sched;
+
+	if (loudness_owns(tscs42xx, ctl->addr, params->max / COEFF_SIZE))
+		return -EBUSY;
+
+	mutex_lock(&sched->lock);
+	if (sched->staging) {
+		memcpy(&sched->staged[ctl->addr * COEFF_SIZE],
+			ucontrol->value.bytes.data, params->max);
+		mutex_unlock(&sched->lock);
+		return 0;
+	}
+	mutex_unlock(&sched->lock);
+
+	if (tscs42xx->group)
+		return group_coeff_ram_update(tscs42xx, ctl->addr,
+			ucontrol->value.bytes.data, params->max / COEFF_SIZE);
+
+	return coeff_ram_update_bg(component, ctl->addr,
+		ucontrol->value.bytes.data, params->max / COEFF_SIZE);
+}
+
+static int volume_put(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	int ret;
+
+	io_begin(tscs42xx, IO_INTERACTIVE);
+	ret = snd_soc_put_volsw(kcontrol, ucontrol);
+	io_end(tscs42xx, IO_INTERACTIVE);
+	if (ret > 0)
+		loudness_schedule(tscs42xx);
+
+	return ret;
+}
+
+/*
+ * Parameter ramp
+ *
+ * Fades a pair of volume registers or prescale coefficients to
+ * "Ramp Value" over "Ramp Duration" milliseconds. The target is picked
+ * with "Ramp Target". Setting "Ramp Switch" starts a ramp from the
+ * current values and clearing it cancels one. The switch drops back to 0,
+ * with a control event, once the target is reached, and the target's own
+ * controls get a value event then too. Volumes ramp in
+ * register steps, so linearly in dB. Prescales ramp linearly in 2.22
+ * gain.
+ *
+ * Steps run every RAMP_STEP_MS from an hrtimer kicked work and write
+ * left and right together. Writes to the target's own controls during
+ * a ramp are overwritten by the next step.
+ */
+#define RAMP_STEP_MS 5
+#define RAMP_DURATION_MAX_MS 10000
+#define RAMP_VALUE_MAX 0xffffff
+
+enum {
+	RAMP_DAC_VOL,
+	RAMP_HP_VOL,
+	RAMP_SPK_VOL,
+	RAMP_CASCADE1_PRESCALE,
+	RAMP_CASCADE2_PRESCALE,
+};
+
+static const struct ramp_target {
+	unsigned int reg[2];	/* coefficient address when coeff is set */
+	unsigned int mask;
+	bool coeff;
+	const char *ctl[2];	/* controls notified on completion */
+} ramp_targets[] = {
+	[RAMP_DAC_VOL] = { { R_DACVOLL, R_DACVOLR }, RM_DACVOLL, false,
+		{ "Master Volume" } },
+	[RAMP_HP_VOL] = { { R_HPVOLL, R_HPVOLR }, RM_HPVOLL, false,
+		{ "Headphone Volume" } },
+	[RAMP_SPK_VOL] = { { R_SPKVOLL, R_SPKVOLR }, RM_SPKVOLL, false,
+		{ "Speaker Volume" } },
+	[RAMP_CASCADE1_PRESCALE] = { { 0x1f, 0x3f }, RAMP_VALUE_MAX, true,
+		{ "Cascade1L Prescale", "Cascade1R Prescale" } },
+	[RAMP_CASCADE2_PRESCALE] = { { 0x5f, 0x7f }, RAMP_VALUE_MAX, true,
+		{ "Cascade2L Prescale", "Cascade2R Prescale" } },
+};
+
+static char const * const ramp_target_text[] = {
+	"DAC Volume", "Headphone Volume", "Speaker Volume",
+	"Cascade1 Prescale", "Cascade2 Prescale",
+};
+
+static const struct soc_enum ramp_target_enum =
+	SOC_ENUM_SINGLE_EXT(ARRAY_SIZE(ramp_target_text), ramp_target_text);
+
+/* Ramp values are signed 2.22 for coefficients, register fields otherwise */
+static inline int ramp_decode(const struct ramp_target *t, unsigned int val)
+{
+	return t->coeff ? sign_extend32(val, 23) : min(val, t->mask);
+}
+
+static int ramp_read(struct tscs42xx *tscs42xx, const struct ramp_target *t,
+	int ch, int *val, unsigned int *keep)
+{
+	u8 data[COEFF_SIZE];
+	unsigned int raw;
+	int ret;
+
+	*keep = 0;
+
+	if (t->coeff) {
+		ret = coeff_ram_read(tscs42xx, t->reg[ch], data, 1);
+		raw = data[0] | (data[1] << 8) | (data[2] << 16);
+	} else {
+		ret = regmap_read(tscs42xx->regmap, t->reg[ch], &raw);
+		*keep = raw & ~t->mask;
+		raw &= t->mask;
+	}
+	if (ret < 0)
+		return ret;
+
+	*val = ramp_decode(t, raw);
+
+	return 0;
+}
+
+static int ramp_write(struct tscs42xx *tscs42xx, const struct ramp_target *t,
+	const int *val)
+{
+	struct tscs42xx_ramp *ramp = &tscs42xx->ramp;
+	struct reg_sequence seq[2];
+	u8 data[2][COEFF_SIZE];
+	int ch;
+	int ret;
+
+	if (!t->coeff) {
+		for (ch = 0; ch < 2; ch++) {
+			seq[ch].reg = t->reg[ch];
+			seq[ch].def = ramp->keep[ch] | val[ch];
+			seq[ch].delay_us = 0;
+		}
+		return regmap_multi_reg_write(tscs42xx->regmap, seq, 2);
+	}
+
+	for (ch = 0; ch < 2; ch++) {
+		data[ch][0] = val[ch] & 0xff;
+		data[ch][1] = (val[ch] >> 8) & 0xff;
+		data[ch][2] = (val[ch] >> 16) & 0xff;
+	}
+
+	/* The prescales are not adjacent, the coefficient bus batches each */
+	for (ch = 0; ch < 2; ch++) {
+		ret = coeff_ram_update(tscs42xx->component, t->reg[ch],
+			data[ch], 1);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+static void ramp_notify(struct snd_soc_component *component,
+	const struct ramp_target *t)
+{
+	char name[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
+	struct snd_kcontrol *kctl;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(t->ctl) && t->ctl[i]; i++) {
+		if (component->name_prefix)
+			snprintf(name, sizeof(name), "%s %s",
+				component->name_prefix, t->ctl[i]);
+		else
+			snprintf(name, sizeof(name), "%s", t->ctl[i]);
+		kctl = snd_soc_card_get_kcontrol(component->card, name);
+		if (kctl)
+			snd_ctl_notify(component->card->snd_card,
+				SNDRV_CTL_EVENT_MASK_VALUE, &kctl->id);
+	}
+}
+
+static enum hrtimer_restart ramp_timer(struct hrtimer *timer)
+{
+	struct tscs42xx_ramp *ramp =
+		container_of(timer, struct tscs42xx_ramp, timer);
+
+	queue_work(system_highpri_wq, &ramp->work);
+
+	return HRTIMER_NORESTART;
+}
+
+static void ramp_work(struct work_struct *work)
+{
+	struct tscs42xx_ramp *ramp =
+		container_of(work, struct tscs42xx_ramp, work);
+	struct tscs42xx *tscs42xx =
+		container_of(ramp, struct tscs42xx, ramp);
+	struct snd_soc_component *component = tscs42xx->component;
+	struct snd_kcontrol *kctl = NULL;
+	const struct ramp_target *t = NULL;
+	int val[2];
+	u64 elapsed;
+	int ch;
+	int ret;
+
+	io_begin(tscs42xx, IO_INTERACTIVE);
+	mutex_lock(&ramp->lock);
+
+	if (!ramp->running)
+		goto exit;
+
+	t = &ramp_targets[ramp->sel];
+	elapsed = ktime_get_ns() - ramp->start_ns;
+
+	for (ch = 0; ch < 2; ch++) {
+		if (elapsed >= ramp->dur_ns)
+			val[ch] = ramp->to;
+		else
+			val[ch] = ramp->from[ch] +
+				div64_s64((s64)(ramp->to - ramp->from[ch]) *
+					(s64)elapsed, ramp->dur_ns);
+	}
+
+	/* Volumes only move every few steps on long ramps */
+	if (val[0] != ramp->last[0] || val[1] != ramp->last[1]) {
+		ret = ramp_write(tscs42xx, t, val);
+		if (ret < 0) {
+			dev_err(component->dev, "Failed ramp step (%d)\n", ret);
+			ramp->running = false;
+			kctl = ramp->kctl;
+			goto exit;
+		}
+		ramp->last[0] = val[0];
+		ramp->last[1] = val[1];
+		if (!t->coeff)
+			loudness_schedule(tscs42xx);
+	}
+
+	if (elapsed >= ramp->dur_ns) {
+		ramp->running = false;
+		kctl = ramp->kctl;
+		goto exit;
+	}
+
+	hrtimer_start(&ramp->timer, ms_to_ktime(RAMP_STEP_MS),
+		HRTIMER_MODE_REL);
+exit:
+	mutex_unlock(&ramp->lock);
+	io_end(tscs42xx, IO_INTERACTIVE);
+
+	/* Completion drops "Ramp Switch" back to 0 and settles the target */
+	if (kctl) {
+		snd_ctl_notify(component->card->snd_card,
+			SNDRV_CTL_EVENT_MASK_VALUE, &kctl->id);
+		ramp_notify(component, t);
+	}
+}
+
+static int ramp_start(struct tscs42xx *tscs42xx)
+{
+	struct tscs42xx_ramp *ramp = &tscs42xx->ramp;
+	const struct ramp_target *t = &ramp_targets[ramp->sel];
+	int ch;
+	int ret;
+
+	for (ch = 0; ch < 2; ch++) {
+		ret = ramp_read(tscs42xx, t, ch, &ramp->from[ch],
+			&ramp->keep[ch]);
+		if (ret < 0)
+			return ret;
+		ramp->last[ch] = ramp->from[ch];
+	}
+
+	ramp->to = ramp_decode(t, ramp->value);
+	ramp->start_ns = ktime_get_ns();
+	ramp->dur_ns = (u64)ramp->duration_ms * NSEC_PER_MSEC;
+	ramp->running = true;
+
+	queue_work(system_highpri_wq, &ramp->work);
+
+	return 0;
+}
+
+static void ramp_cancel(struct tscs42xx_ramp *ramp)
+{
+	mutex_lock(&ramp->lock);
+	ramp->running = false;
+	mutex_unlock(&ramp->lock);
+
+	hrtimer_cancel(&ramp->timer);
+	cancel_work_sync(&ramp->work);
+}
+
+static void ramp_init(struct tscs42xx_ramp *ramp)
+{
+	mutex_init(&ramp->lock);
+	ramp->duration_ms = 1000;
+	hrtimer_init(&ramp->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ramp->timer.function = ramp_timer;
+	INIT_WORK(&ramp->work, ramp_work);
+}
+
+static int ramp_target_get(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	mutex_lock(&tscs42xx->ramp.lock);
+	ucontrol->value.enumerated.item[0] = tscs42xx->ramp.sel;
+	mutex_unlock(&tscs42xx->ramp.lock);
+
+	return 0;
+}
+
+static int ramp_target_put(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	struct tscs42xx_ramp *ramp = &tscs42xx->ramp;
+	unsigned int sel = ucontrol->value.enumerated.item[0];
+	int ret = 0;
+
+	if (sel >= ARRAY_SIZE(ramp_target_text))
+		return -EINVAL;
+
+	mutex_lock(&ramp->lock);
+	if (ramp->running) {
+		/* Cancel the ramp first */
+		ret = -EBUSY;
+	} else if (ramp->sel != sel) {
+		ramp->sel = sel;
+		ret = 1;
+	}
+	mutex_unlock(&ramp->lock);
+
+	return ret;
+}
+
+static int ramp_param_put(struct tscs42xx_ramp *ramp, unsigned int *param,
+	long val, long max)
+{
+	int ret = 0;
+
+	if (val < 0 || val > max)
+		return -EINVAL;
+
+	mutex_lock(&ramp->lock);
+	if (*param != val) {
+		*param = val;
+		ret = 1;
+	}
+	mutex_unlock(&ramp->lock);
+
+	return ret;
+}
+
+static int ramp_value_get(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	mutex_lock(&tscs42xx->ramp.lock);
+	ucontrol->value.integer.value[0] = tscs42xx->ramp.value;
+	mutex_unlock(&tscs42xx->ramp.lock);
+
+	return 0;
+}
+
+static int ramp_value_put(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	return ramp_param_put(&tscs42xx->ramp, &tscs42xx->ramp.value,
+		ucontrol->value.integer.value[0], RAMP_VALUE_MAX);
+}
+
+static int ramp_duration_get(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	mutex_lock(&tscs42xx->ramp.lock);
+	ucontrol->value.integer.value[0] = tscs42xx->ramp.duration_ms;
+	mutex_unlock(&tscs42xx->ramp.lock);
+
+	return 0;
+}
+
+static int ramp_duration_put(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	return ramp_param_put(&tscs42xx->ramp, &tscs42xx->ramp.duration_ms,
+		ucontrol->value.integer.value[0], RAMP_DURATION_MAX_MS);
+}
+
+static int ramp_switch_get(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	mutex_lock(&tscs42xx->ramp.lock);
+	ucontrol->value.integer.value[0] = tscs42xx->ramp.running;
+	mutex_unlock(&tscs42xx->ramp.lock);
+
+	return 0;
+}
+
+static int ramp_switch_put(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	struct tscs42xx_ramp *ramp = &tscs42xx->ramp;
+	bool on = !!ucontrol->value.integer.value[0];
+	bool was;
+	int ret;
+
+	if (!on) {
+		mutex_lock(&ramp->lock);
+		was = ramp->running;
+		mutex_unlock(&ramp->lock);
+		ramp_cancel(ramp);
+		return was;
+	}
+
+	/*
+	 * Restarting a running ramp continues from where it is. The old
+	 * timer and step are stopped first so only one ramp moves the target.
+	 */
+	mutex_lock(&ramp->lock);
+	was = ramp->running;
+	mutex_unlock(&ramp->lock);
+	if (was)
+		ramp_cancel(ramp);
+
+	mutex_lock(&ramp->lock);
+	ramp->kctl = kcontrol;
+	ret = ramp_start(tscs42xx);
+	mutex_unlock(&ramp->lock);
+	if (ret < 0) {
+		dev_err(component->dev, "Failed to start ramp (%d)\n", ret);
+		return ret;
+	}
+
+	return !was;
+}
+
+/*
+ * Scheduled coefficient switch
+ *
+ * With "Coeff Stage Switch" on, coefficient control writes go to a staged
+ * image instead of the chip. Writing a playback frame position to
+ * "Coeff Stage Frame" arms the switch: the coefficients that differ are
+ * collected up front, and the flush is started so that its midpoint lands
+ * on the target frame. Arming with no running playback stream, or with a
+ * position that has already passed, applies the image at once.
+ *
+ * The biquads loudness compensation owns are left out of the flush, since
+ * the staged copy of them goes stale as the volume moves. Grouped
+ * instances can't stage: a switch timed to one codec's stream can't be
+ * fanned out to the others on time, so their members would drift apart.
+ *
+ * The hw pointer only moves at period boundaries on most platforms, so
+ * the position is extrapolated from the last observed pointer update. The
+ * timer sleeps until about a period before the target and then polls
+ * for the next update.
+ */
+#define COEFF_SCHED_POLL_NS (250 * NSEC_PER_USEC)
+#define COEFF_SCHED_FLUSH_US 1000
+
+static inline s64 frames_to_ns(s64 frames, unsigned int rate)
+{
+	return div_s64(frames * NSEC_PER_SEC, rate);
+}
+
+/* Called with stream_lock held and a substream attached */
+static s64 coeff_sched_pos(struct coeff_sched *sched, ktime_t now)
+{
+	struct snd_pcm_runtime *runtime = sched->substream->runtime;
+	snd_pcm_uframes_t ptr = READ_ONCE(runtime->status->hw_ptr);
+	s64 elapsed;
+
+	if (ptr != sched->last_ptr) {
+		sched->last_ptr = ptr;
+		sched->last_ts = now;
+	}
+
+	elapsed = div_s64(ktime_to_ns(ktime_sub(now, sched->last_ts)) *
+		runtime->rate, NSEC_PER_SEC);
+
+	return ptr + min_t(s64, elapsed, runtime->period_size);
+}
+
+static enum hrtimer_restart coeff_sched_timer(struct hrtimer *timer)
+{
+	struct coeff_sched *sched =
+		container_of(timer, struct coeff_sched, timer);
+	enum hrtimer_restart restart = HRTIMER_NORESTART;
+	struct snd_pcm_runtime *runtime;
+	unsigned long flags;
+	s64 remaining;
+	s64 lead;
+	s64 delay;
+
+	spin_lock_irqsave(&sched->stream_lock, flags);
+
+	if (!sched->substream || sched->target < 0)
+		goto exit;
+
+	runtime = sched->substream->runtime;
+
+	/* Center the flush on the target */
+	lead = div_u64((u64)READ_ONCE(sched->flush_us) * runtime->rate,
+		2 * USEC_PER_SEC);
+	remaining = sched->target - lead - coeff_sched_pos(sched, ktime_get());
+	if (remaining <= 0) {
+		queue_work(system_highpri_wq, &sched->work);
+		goto exit;
+	}
+
+	if (remaining > 2 * (s64)runtime->period_size)
+		delay = frames_to_ns(remaining - runtime->period_size,
+			runtime->rate);
+	else
+		delay = min_t(s64, frames_to_ns(remaining, runtime->rate),
+			COEFF_SCHED_POLL_NS);
+
+	hrtimer_forward_now(timer, ns_to_ktime(delay));
+	restart = HRTIMER_RESTART;
+exit:
+	spin_unlock_irqrestore(&sched->stream_lock, flags);
+
+	return restart;
+}
+
+static void coeff_sched_work(struct work_struct *work)
+{
+	struct coeff_sched *sched =
+		container_of(work, struct coeff_sched, work);
+	struct tscs42xx *tscs42xx =
+		container_of(sched, struct tscs42xx, sched);
+	unsigned int start, end;
+	unsigned long flags;
+	ktime_t t0, t1;
+	s64 target;
+	s64 err;
+	bool measured = false;
+	struct qos_upload up;
+	unsigned int i;
+	int ret;
+
+	mutex_lock(&sched->lock);
+
+	spin_lock_irqsave(&sched->stream_lock, flags);
+	target = sched->target;
+	spin_unlock_irqrestore(&sched->stream_lock, flags);
+	if (target < 0)
+		goto exit;
+
+	/* Loudness may have been enabled since arming */
+	for_each_set_bit(i, sched->dirty, COEFF_RAM_COEFF_COUNT)
+		if (loudness_owns(tscs42xx, i, 1))
+			clear_bit(i, sched->dirty);
+
+	qos_upload_begin(tscs42xx, &up);
+	t0 = ktime_get();
+	for (start = find_first_bit(sched->dirty, COEFF_RAM_COEFF_COUNT);
+	     start < COEFF_RAM_COEFF_COUNT;
+	     start = find_next_bit(sched->dirty, COEFF_RAM_COEFF_COUNT, end)) {
+		end = find_next_zero_bit(sched->dirty, COEFF_RAM_COEFF_COUNT,
+			start);
+		ret = coeff_ram_update(tscs42xx->component, start,
+			&sched->staged[start * COEFF_SIZE], end - start);
+		if (ret < 0)
+			dev_err(tscs42xx->component->dev,
+				"Failed to apply staged coefficients (%d)\n",
+				ret);
+	}
+	t1 = ktime_get();
+	qos_upload_end(tscs42xx, &up);
+	bitmap_zero(sched->dirty, COEFF_RAM_COEFF_COUNT);
+
+	spin_lock_irqsave(&sched->stream_lock, flags);
+	if (sched->substream) {
+		err = coeff_sched_pos(sched,
+			ktime_add_ns(t0, ktime_to_ns(ktime_sub(t1, t0)) / 2)) -
+			target;
+		measured = true;
+	}
+	sched->target = -1;
+	spin_unlock_irqrestore(&sched->stream_lock, flags);
+
+	WRITE_ONCE(sched->flush_us, ktime_us_delta(t1, t0));
+	if (measured) {
+		sched->last_err = err;
+		if (abs(err) > sched->max_err)
+			sched->max_err = abs(err);
+		if (err > 0)
+			sched->late_cnt++;
+	}
+exit:
+	mutex_unlock(&sched->lock);
+}
+
+/* Called from trigger with the stream attached or detached */
+static void coeff_sched_stream(struct coeff_sched *sched,
+	struct snd_pcm_substream *substream)
+{
+	unsigned long flags;
+	bool armed;
+
+	spin_lock_irqsave(&sched->stream_lock, flags);
+	sched->substream = substream;
+	if (substream) {
+		sched->last_ptr = READ_ONCE(substream->runtime->status->hw_ptr);
+		sched->last_ts = ktime_get();
+	}
+	armed = sched->target >= 0;
+	spin_unlock_irqrestore(&sched->stream_lock, flags);
+
+	if (!armed)
+		return;
+
+	if (substream) {
+		hrtimer_start(&sched->timer, 0, HRTIMER_MODE_REL);
+	} else {
+		/* The stream is gone so the target can't be met, apply now */
+		hrtimer_try_to_cancel(&sched->timer);
+		queue_work(system_highpri_wq, &sched->work);
+	}
+}
+
+static int coeff_sched_arm(struct tscs42xx *tscs42xx, s64 target)
+{
+	struct coeff_sched *sched = &tscs42xx->sched;
+	u8 cur[COEFF_SIZE];
+	unsigned long flags;
+	bool running;
+	int i;
+
+	mutex_lock(&sched->lock);
+
+	if (!sched->staging) {
+		mutex_unlock(&sched->lock);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < COEFF_RAM_COEFF_COUNT; i++) {
+		if (loudness_owns(tscs42xx, i, 1))
+			continue;
+		if (coeff_ram_read(tscs42xx, i, cur, 1) < 0 ||
+		    memcmp(cur, &sched->staged[i * COEFF_SIZE], COEFF_SIZE))
+			set_bit(i, sched->dirty);
+	}
+	sched->staging = false;
+
+	spin_lock_irqsave(&sched->stream_lock, flags);
+	sched->target = target;
+	running = sched->substream != NULL;
+	spin_unlock_irqrestore(&sched->stream_lock, flags);
+
+	mutex_unlock(&sched->lock);
+
+	if (running)
+		hrtimer_start(&sched->timer, 0, HRTIMER_MODE_REL);
+	else
+		queue_work(system_highpri_wq, &sched->work);
+
+	return 0;
+}
+
+static void coeff_sched_cancel(struct coeff_sched *sched)
+{
+	hrtimer_cancel(&sched->timer);
+	cancel_work_sync(&sched->work);
+}
+
+static void coeff_sched_init(struct coeff_sched *sched)
+{
+	mutex_init(&sched->lock);
+	spin_lock_init(&sched->stream_lock);
+	sched->target = -1;
+	sched->flush_us = COEFF_SCHED_FLUSH_US;
+	hrtimer_init(&sched->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	sched->timer.function = coeff_sched_timer;
+	INIT_WORK(&sched->work, coeff_sched_work);
+}
+
+static int coeff_stage_get(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	mutex_lock(&tscs42xx->sched.lock);
+	ucontrol->value.integer.value[0] = tscs42xx->sched.staging;
+	mutex_unlock(&tscs42xx->sched.lock);
+
+	return 0;
+}
+
+static int coeff_stage_put(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	struct coeff_sched *sched = &tscs42xx->sched;
+	bool staging = !!ucontrol->value.integer.value[0];
+	int ret = 0;
+
+	if (staging && tscs42xx->group)
+		return -EBUSY;
+
+	mutex_lock(&sched->lock);
+
+	if (sched->staging == staging)
+		goto exit;
+
+	/* Start from the live image, turning staging off discards it */
+	if (staging) {
+		ret = coeff_ram_read(tscs42xx, 0, sched->staged,
+			COEFF_RAM_COEFF_COUNT);
 		if (ret < 0)
 			goto exit;
-		tscs42xx->coeff_ram_synced = true;
 	}
+	sched->staging = staging;
+	ret = 1;
+exit:
+	mutex_unlock(&sched->lock);
+
+	return ret;
+}
+
+static int coeff_stage_frame_info(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER64;
+	uinfo->count = 1;
+	uinfo->value.integer64.min = -1;
+	uinfo->value.integer64.max = LLONG_MAX;
+
+	return 0;
+}
+
+static int coeff_stage_frame_get(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	unsigned long flags;
+
+	spin_lock_irqsave(&tscs42xx->sched.stream_lock, flags);
+	ucontrol->value.integer64.value[0] = tscs42xx->sched.target;
+	spin_unlock_irqrestore(&tscs42xx->sched.stream_lock, flags);
+
+	return 0;
+}
+
+static int coeff_stage_frame_put(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	s64 target = ucontrol->value.integer64.value[0];
+	int ret;
+
+	if (target < 0)
+		return -EINVAL;
+
+	ret = coeff_sched_arm(tscs42xx, target);
+	if (ret < 0) {
+		dev_err(component->dev,
+			"Failed to arm coefficient switch (%d)\n", ret);
+		return ret;
+	}
+
+	return 1;
+}
+
+static int coeff_stage_stats_info(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 4;
+	uinfo->value.integer.min = INT_MIN;
+	uinfo->value.integer.max = INT_MAX;
+
+	return 0;
+}
+
+/* Last error and max error in frames, last flush time in us, late count */
+static int coeff_stage_stats_get(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	struct coeff_sched *sched = &tscs42xx->sched;
+
+	mutex_lock(&sched->lock);
+	ucontrol->value.integer.value[0] =
+		clamp_t(s64, sched->last_err, INT_MIN, INT_MAX);
+	ucontrol->value.integer.value[1] = min_t(s64, sched->max_err, INT_MAX);
+	ucontrol->value.integer.value[2] = READ_ONCE(sched->flush_us);
+	ucontrol->value.integer.value[3] = sched->late_cnt;
+	mutex_unlock(&sched->lock);
+
+	return 0;
+}
+
+/*
+ * Low latency DSP bypass
+ *
+ * Playback streams with a period shorter than "DSP Bypass Period" frames
+ * run with the selected DAC DSP blocks off to avoid their group delay.
+ * The enable bits are saved and cleared at hw_params and put back at
+ * hw_free. Only bits that actually change are written. Profiles and
+ * checkpoints written meanwhile go through dsp_bypass_filter().
+ */
+#define DSP_BYPASS_PERIOD_MAX 8192
+
+static const struct {
+	unsigned int reg;
+	unsigned int mask;
+} dsp_bypass_regs[DSP_BYPASS_CNT] = {
+	[DSP_BYPASS_EQ] = {
+		R_CONFIG1, RM_CONFIG1_EQ1_EN | RM_CONFIG1_EQ2_EN,
+	},
+	[DSP_BYPASS_FX] = {
+		R_FXCTL, RM_FXCTL_3DEN | RM_FXCTL_TEEN | RM_FXCTL_BEEN,
+	},
+	[DSP_BYPASS_MBC] = {
+		R_DACMBCEN, RM_DACMBCEN_MBCEN1 | RM_DACMBCEN_MBCEN2 |
+			RM_DACMBCEN_MBCEN3,
+	},
+};
+
+/* Called from hw_params and hw_free */
+static int dsp_bypass_update(struct snd_soc_component *component,
+	bool bypass)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	unsigned int blocks = READ_ONCE(tscs42xx->bypass_blocks);
+	unsigned int reg, mask;
+	unsigned int val;
+	int ret = 0;
+	int i;
+
+	mutex_lock(&tscs42xx->bypass_lock);
+
+	if (tscs42xx->bypassed == bypass)
+		goto exit;
+
+	for (i = 0; i < DSP_BYPASS_CNT; i++) {
+		reg = dsp_bypass_regs[i].reg;
+		mask = dsp_bypass_regs[i].mask;
+
+		if (bypass) {
+			tscs42xx->bypass_saved[i] = 0;
+			if (!(blocks & BIT(i)))
+				continue;
+			ret = snd_soc_component_read(component, reg, &val);
+			if (ret < 0) {
+				dev_err(component->dev,
+					"Failed to read DSP enables (%d)\n",
+					ret);
+				goto exit;
+			}
+			tscs42xx->bypass_saved[i] = val & mask;
+			ret = snd_soc_component_update_bits(component, reg,
+				mask, 0);
+		} else {
+			/* Only enables we cleared, user changes are kept */
+			if (!tscs42xx->bypass_saved[i])
+				continue;
+			ret = snd_soc_component_update_bits(component, reg,
+				tscs42xx->bypass_saved[i],
+				tscs42xx->bypass_saved[i]);
+		}
+		if (ret < 0) {
+			dev_err(component->dev,
+				"Failed to update DSP enables (%d)\n", ret);
+			goto exit;
+		}
+	}
+
+	tscs42xx->bypassed = bypass;
+	tscs42xx->bypass_active = bypass ? blocks : 0;
+	ret = 0;
+exit:
+	mutex_unlock(&tscs42xx->bypass_lock);
+
+	return ret;
+}
+
+/*
+ * Value to write for a register image entry. While bypassed, enables of
+ * the cleared blocks are kept off and land in bypass_saved for hw_free
+ * to put back. Called with bypass_lock held.
+ */
+static unsigned int dsp_bypass_filter(struct tscs42xx *tscs42xx,
+	unsigned int reg, unsigned int val)
+{
+	unsigned int mask;
+	int i;
+
+	if (!tscs42xx->bypassed)
+		return val;
+
+	for (i = 0; i < DSP_BYPASS_CNT; i++) {
+		if (dsp_bypass_regs[i].reg != reg ||
+		    !(tscs42xx->bypass_active & BIT(i)))
+			continue;
+		mask = dsp_bypass_regs[i].mask;
+		tscs42xx->bypass_saved[i] = val & mask;
+		val &= ~mask;
+	}
+
+	return val;
+}
+
+static int dsp_bypass_period_get(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	ucontrol->value.integer.value[0] = READ_ONCE(tscs42xx->bypass_period);
+
+	return 0;
+}
+
+static int dsp_bypass_period_put(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	long period = ucontrol->value.integer.value[0];
+
+	if (period < 0 || period > DSP_BYPASS_PERIOD_MAX)
+		return -EINVAL;
+
+	if (READ_ONCE(tscs42xx->bypass_period) == period)
+		return 0;
+
+	WRITE_ONCE(tscs42xx->bypass_period, period);
+
+	return 1;
+}
+
+static int dsp_bypass_block_get(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	ucontrol->value.integer.value[0] = !!(READ_ONCE(
+		tscs42xx->bypass_blocks) & BIT(kcontrol->private_value));
+
+	return 0;
+}
+
+static int dsp_bypass_block_put(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	unsigned int blocks = READ_ONCE(tscs42xx->bypass_blocks);
+	unsigned int bit = BIT(kcontrol->private_value);
+
+	if (!!(blocks & bit) == !!ucontrol->value.integer.value[0])
+		return 0;
+
+	WRITE_ONCE(tscs42xx->bypass_blocks, blocks ^ bit);
+
+	return 1;
+}
+
+/*
+ * DC removal
+ *
+ * The single pole DC filter corner is about fs * 2^-n / 2pi. "Auto" picks
+ * n per sample rate to keep the corner near 3 Hz, the fixed settings are
+ * written as is.
+ */
+#define DC_CORNER_DIV 19	/* 2pi * 3 Hz */
+
+static char const * const dc_coef_sel_text[] = {
+	"Auto", "2^-8", "2^-9", "2^-10", "2^-11",
+	"2^-12", "2^-13", "2^-14", "2^-15",
+};
+
+static const struct soc_enum dc_coef_sel_enum =
+	SOC_ENUM_SINGLE_EXT(ARRAY_SIZE(dc_coef_sel_text), dc_coef_sel_text);
+
+static int dc_coef_update(struct snd_soc_component *component)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	unsigned int sel = READ_ONCE(tscs42xx->dc_coef_sel);
+	int rate = READ_ONCE(tscs42xx->samplerate);
+	unsigned int val;
+	int ret;
+
+	if (sel) {
+		val = sel - 1;
+	} else if (rate) {
+		val = clamp(ilog2(rate / DC_CORNER_DIV), 8, 15) - 8;
+	} else {
+		/* No rate yet, hw_params sets it */
+		return 0;
+	}
+
+	ret = snd_soc_component_update_bits(component, R_DCOFSEL,
+		RM_DCOFSEL_DC_COEF_SEL, val << FB_DCOFSEL_DC_COEF_SEL);
+	if (ret < 0) {
+		dev_err(component->dev,
+			"Failed to set DC filter corner (%d)\n", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+static int dc_coef_sel_get(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	ucontrol->value.enumerated.item[0] = READ_ONCE(tscs42xx->dc_coef_sel);
+
+	return 0;
+}
+
+static int dc_coef_sel_put(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	unsigned int sel = ucontrol->value.enumerated.item[0];
+	int ret;
+
+	if (sel >= ARRAY_SIZE(dc_coef_sel_text))
+		return -EINVAL;
+
+	if (READ_ONCE(tscs42xx->dc_coef_sel) == sel)
+		return 0;
+
+	WRITE_ONCE(tscs42xx->dc_coef_sel, sel);
+
+	ret = dc_coef_update(component);
+	if (ret < 0)
+		return ret;
+
+	return 1;
+}
+
+/* Input L Capture Route */
+static char const * const input_select_text[] = {
+	"Line 1", "Line 2", "Line 3", "D2S"
+};
+
+static const struct soc_enum left_input_select_enum =
+SOC_ENUM_SINGLE(R_INSELL, FB_INSELL, ARRAY_SIZE(input_select_text),
+		input_select_text);
+
+static const struct snd_kcontrol_new left_input_select =
+SOC_DAPM_ENUM("LEFT_INPUT_SELECT_ENUM", left_input_select_enum);
+
+/* Input R Capture Route */
+static const struct soc_enum right_input_select_enum =
+SOC_ENUM_SINGLE(R_INSELR, FB_INSELR, ARRAY_SIZE(input_select_text),
+		input_select_text);
+
+static const struct snd_kcontrol_new right_input_select =
+SOC_DAPM_ENUM("RIGHT_INPUT_SELECT_ENUM", right_input_select_enum);
+
+/* Input Channel Mapping */
+static char const * const ch_map_select_text[] = {
+	"Normal", "Left to Right", "Right to Left", "Swap"
+};
+
+static const struct soc_enum ch_map_select_enum =
+SOC_ENUM_SINGLE(R_AIC2, FB_AIC2_ADCDSEL, ARRAY_SIZE(ch_map_select_text),
+		ch_map_select_text);
+
+static int dapm_vref_event(struct snd_soc_dapm_widget *w,
+			 struct snd_kcontrol *kcontrol, int event)
+{
+	msleep(20);
+	return 0;
+}
+
+static int dapm_micb_event(struct snd_soc_dapm_widget *w,
+			 struct snd_kcontrol *kcontrol, int event)
+{
+	msleep(20);
+	return 0;
+}
+
+static int pll_event(struct snd_soc_dapm_widget *w,
+		     struct snd_kcontrol *kcontrol, int event)
+{
+	struct snd_soc_component *component =
+		snd_soc_dapm_to_component(w->dapm);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	u8 path = journal_path_push(tscs42xx, JOURNAL_PATH_DAPM);
+	int ret;
+
+	io_begin(tscs42xx, IO_CRITICAL);
+
+	if (SND_SOC_DAPM_EVENT_ON(event))
+		ret = power_up_audio_plls(component);
+	else
+		ret = power_down_audio_plls(component);
+
+	io_end(tscs42xx, IO_CRITICAL);
+	journal_path_pop(tscs42xx, path);
+
+	return ret;
+}
+
+/* Sync the coefficient RAM range written while the PLL was down */
+static int coeff_ram_flush(struct snd_soc_component *component)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	unsigned int lo, hi;
+	u8 path;
+	struct qos_upload up;
+	int ret;
+
+	ret = async_barrier(component);
+	if (ret < 0)
+		return ret;
+
+	mutex_lock(&tscs42xx->coeff_ram_lock);
+
+	if (tscs42xx->coeff_ram_dirty) {
+		regcache_cache_only(tscs42xx->coeff_regmap, false);
+		path = journal_path_push(tscs42xx, JOURNAL_PATH_COEFF);
+		qos_upload_begin(tscs42xx, &up);
+		for (lo = tscs42xx->coeff_dirty_lo;
+		     lo <= tscs42xx->coeff_dirty_hi; lo = hi + 1) {
+			hi = min(lo + COEFF_BURST_COUNT - 1,
+				tscs42xx->coeff_dirty_hi);
+			ret = regcache_sync_region(tscs42xx->coeff_regmap,
+				lo, hi);
+			if (ret < 0)
+				break;
+		}
+		qos_upload_end(tscs42xx, &up);
+		journal_path_pop(tscs42xx, path);
+		if (ret < 0) {
+			dev_err(component->dev,
+				"Failed to sync coeff ram (%d)\n", ret);
+			goto exit;
+		}
+		tscs42xx->coeff_ram_dirty = false;
+	}
+
+	ret = 0;
+exit:
+	mutex_unlock(&tscs42xx->coeff_ram_lock);
+
+	return ret;
+}
+
+/*
+ * Dynamics time constants
+ *
+ * The CLE and MBC attack and release registers are taken to be one pole
+ * smoothing coefficients of the level detector: the fraction of the
+ * distance to the new level covered each sample, larger being faster.
+ * For time constants well above a sample period that fraction is about
+ * 1 / (tau * rate), so a fixed value responds faster at higher rates
+ * (more steps per second) and slower at lower ones. The controls hold the
+ * value that applies at 48 kHz and the registers get it scaled by
+ * 48000 / rate, which keeps tau in seconds, rewritten whenever the rate
+ * changes.
+ */
+#define TIME_CONST_REF_RATE 48000
+
+static const unsigned int time_const_regs[TIME_CONST_CNT] = {
+	[TIME_CONST_CLE_ATK] = R_CATKTCL,
+	[TIME_CONST_MBC1_ATK] = R_DACMBCATK1L,
+	[TIME_CONST_MBC1_REL] = R_DACMBCREL1L,
+	[TIME_CONST_MBC2_ATK] = R_DACMBCATK2L,
+	[TIME_CONST_MBC2_REL] = R_DACMBCREL2L,
+	[TIME_CONST_MBC3_ATK] = R_DACMBCATK3L,
+	[TIME_CONST_MBC3_REL] = R_DACMBCREL3L,
+};
+
+static unsigned int time_const_scale(u16 ref, int rate)
+{
+	u64 val;
+
+	if (!rate || !ref)
+		return ref;
+
+	val = DIV_ROUND_CLOSEST_ULL((u64)ref * TIME_CONST_REF_RATE, rate);
+
+	return clamp_t(u64, val, 1, 0xffff);
+}
+
+static void time_const_seq(struct tscs42xx *tscs42xx, int idx, int rate,
+	struct reg_sequence *seq)
+{
+	unsigned int val = time_const_scale(tscs42xx->time_const[idx], rate);
+
+	seq[0].reg = time_const_regs[idx];
+	seq[0].def = val & 0xff;
+	seq[1].reg = time_const_regs[idx] + 1;
+	seq[1].def = val >> 8;
+}
+
+/* Rescale all time constants for a new rate in one multi write */
+static int time_const_update(struct snd_soc_component *component, int rate)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	struct reg_sequence seq[TIME_CONST_CNT * 2];
+	int ret = 0;
+	int i;
+
+	mutex_lock(&tscs42xx->time_const_lock);
+
+	if (rate == tscs42xx->time_const_rate)
+		goto exit;
+
+	for (i = 0; i < TIME_CONST_CNT; i++)
+		time_const_seq(tscs42xx, i, rate, &seq[i * 2]);
+
+	ret = regmap_multi_reg_write(tscs42xx->regmap, seq, ARRAY_SIZE(seq));
+	if (ret < 0) {
+		dev_err(component->dev,
+			"Failed to rescale time constants (%d)\n", ret);
+		goto exit;
+	}
+
+	tscs42xx->time_const_rate = rate;
+exit:
+	mutex_unlock(&tscs42xx->time_const_lock);
+
+	return ret;
+}
+
+/* Power on values are taken as the 48 kHz references */
+static int time_const_init(struct tscs42xx *tscs42xx)
+{
+	u8 val[2];
+	int ret;
+	int i;
+
+	mutex_init(&tscs42xx->time_const_lock);
+
+	for (i = 0; i < TIME_CONST_CNT; i++) {
+		ret = regmap_bulk_read(tscs42xx->regmap, time_const_regs[i],
+			val, ARRAY_SIZE(val));
+		if (ret < 0)
+			return ret;
+		tscs42xx->time_const[i] = val[0] | (val[1] << 8);
+	}
+
+	return 0;
+}
+
+/* Index of the time constant a register belongs to, or -1 */
+static int time_const_idx(unsigned int reg, unsigned int *shift)
+{
+	int i;
+
+	for (i = 0; i < TIME_CONST_CNT; i++) {
+		if (reg == time_const_regs[i] || reg == time_const_regs[i] + 1) {
+			*shift = (reg - time_const_regs[i]) * 8;
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Register image writes (profiles, checkpoints) of a time constant byte
+ * take it as the 48 kHz reference, the same as the controls
+ */
+static int time_const_set(struct snd_soc_component *component, int idx,
+	unsigned int shift, unsigned int val)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	struct reg_sequence seq[2];
+	u16 ref;
+	int ret = 0;
+
+	mutex_lock(&tscs42xx->time_const_lock);
+
+	ref = (tscs42xx->time_const[idx] & ~(0xff << shift)) |
+		((val & 0xff) << shift);
+	if (tscs42xx->time_const[idx] == ref)
+		goto exit;
+
+	tscs42xx->time_const[idx] = ref;
+	time_const_seq(tscs42xx, idx, tscs42xx->time_const_rate, seq);
+	ret = regmap_multi_reg_write(tscs42xx->regmap, seq, ARRAY_SIZE(seq));
+	if (ret < 0)
+		dev_err(component->dev,
+			"Failed to set time constant (%d)\n", ret);
+exit:
+	mutex_unlock(&tscs42xx->time_const_lock);
+
+	return ret;
+}
+
+static int time_const_info(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_BYTES;
+	uinfo->count = 2;
+
+	return 0;
+}
+
+static int time_const_get(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	int idx = kcontrol->private_value;
+
+	mutex_lock(&tscs42xx->time_const_lock);
+	ucontrol->value.bytes.data[0] = tscs42xx->time_const[idx] & 0xff;
+	ucontrol->value.bytes.data[1] = tscs42xx->time_const[idx] >> 8;
+	mutex_unlock(&tscs42xx->time_const_lock);
+
+	return 0;
+}
+
+static int time_const_put(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	int idx = kcontrol->private_value;
+	u16 ref = ucontrol->value.bytes.data[0] |
+		(ucontrol->value.bytes.data[1] << 8);
+	struct reg_sequence seq[2];
+	int ret = 0;
+
+	mutex_lock(&tscs42xx->time_const_lock);
+
+	if (tscs42xx->time_const[idx] == ref)
+		goto exit;
+
+	tscs42xx->time_const[idx] = ref;
+	time_const_seq(tscs42xx, idx, tscs42xx->time_const_rate, seq);
+	ret = regmap_multi_reg_write(tscs42xx->regmap, seq, ARRAY_SIZE(seq));
+	if (ret < 0) {
+		dev_err(component->dev,
+			"Failed to set time constant (%d)\n", ret);
+		goto exit;
+	}
+
+	ret = 1;
+exit:
+	mutex_unlock(&tscs42xx->time_const_lock);
+
+	return ret;
+}
+
+/*
+ * Output profiles
+ *
+ * Speaker and headphone each can carry a DSP profile: a full coefficient
+ * RAM image plus register/value pairs (EQ, CLE, MBC and effect settings,
+ * see profile_reg_valid()). Time constants are 48 kHz references as with
+ * their controls, and enables of blocks bypassed for a running stream
+ * take effect at hw_free.
+ * Layout, little endian:
+ *
+ *	"T42P", u16 version (1), u16 num_regs,
+ *	COEFF_RAM_SIZE bytes coefficient image (control byte order),
+ *	num_regs x { u8 reg, u8 val }
+ *
+ * Profiles come from the "Speaker Profile"/"Headphone Profile" TLV byte
+ * controls or from firmware files named in DT. When DAPM powers an output
+ * DAC the profile of the powered path is applied before the DAC comes up,
+ * headphone taking precedence if both are. Only coefficients and
+ * registers that differ are written, so a path that stays on costs
+ * nothing and the stream is still muted while it happens. Biquads owned
+ * by loudness compensation keep their shelves.
+ */
+#define PROFILE_VERSION 1
+
+/* EQ, CLE, MBC and effect registers, the only ones a profile may carry */
+static bool profile_reg_valid(unsigned int reg)
+{
+	return reg == R_CONFIG1 ||
+		(reg >= R_CLECTL && reg <= R_FXCTL) ||
+		(reg >= R_DACMBCEN && reg <= R_DACMBCREL3H);
+}
+
+static int profile_check(struct snd_soc_component *component,
+	const u8 *data, unsigned int size)
+{
+	const struct profile_hdr *hdr = (const void *)data;
+	unsigned int num_regs;
+	const u8 *regs;
+	int i;
+
+	if (size < sizeof(*hdr) + COEFF_RAM_SIZE ||
+	    memcmp(hdr->magic, "T42P", sizeof(hdr->magic)) ||
+	    le16_to_cpu(hdr->version) != PROFILE_VERSION)
+		return -EINVAL;
+
+	num_regs = le16_to_cpu(hdr->num_regs);
+	if (num_regs > PROFILE_MAX_REGS ||
+	    size != sizeof(*hdr) + COEFF_RAM_SIZE + num_regs * 2)
+		return -EINVAL;
+
+	regs = data + sizeof(*hdr) + COEFF_RAM_SIZE;
+	for (i = 0; i < num_regs; i++) {
+		if (!profile_reg_valid(regs[i * 2]))
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int profile_apply(struct snd_soc_component *component, int idx)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	const u8 *data = tscs42xx->profiles[idx].data;
+	const struct profile_hdr *hdr = (const void *)data;
+	const u8 *coeffs = data + sizeof(*hdr);
+	const u8 *regs = coeffs + COEFF_RAM_SIZE;
+	DECLARE_BITMAP(dirty, COEFF_RAM_COEFF_COUNT);
+	unsigned int start, end;
+	unsigned int reg, val, shift;
+	u8 cur[COEFF_SIZE];
+	int ret = 0;
+	struct qos_upload up;
+	int tc;
+	int i;
+
+	bitmap_zero(dirty, COEFF_RAM_COEFF_COUNT);
+	for (i = 0; i < COEFF_RAM_COEFF_COUNT; i++) {
+		ret = coeff_ram_read(tscs42xx, i, cur, 1);
+		if (ret < 0)
+			return ret;
+		if (memcmp(cur, &coeffs[i * COEFF_SIZE], COEFF_SIZE) &&
+		    !loudness_owns(tscs42xx, i, 1))
+			set_bit(i, dirty);
+	}
+
+	/* Write back runs of coefficients that differ from the cache */
+	qos_upload_begin(tscs42xx, &up);
+	for (start = find_first_bit(dirty, COEFF_RAM_COEFF_COUNT);
+	     start < COEFF_RAM_COEFF_COUNT;
+	     start = find_next_bit(dirty, COEFF_RAM_COEFF_COUNT, end)) {
+		end = find_next_zero_bit(dirty, COEFF_RAM_COEFF_COUNT, start);
+		ret = coeff_ram_update(component, start,
+			&coeffs[start * COEFF_SIZE], end - start);
+		if (ret < 0)
+			break;
+	}
+	qos_upload_end(tscs42xx, &up);
+	if (ret < 0)
+		return ret;
+
+	/* update_bits skips registers that already hold the value */
+	mutex_lock(&tscs42xx->bypass_lock);
+	for (i = 0; i < le16_to_cpu(hdr->num_regs); i++) {
+		reg = regs[i * 2];
+		val = regs[i * 2 + 1];
+		tc = time_const_idx(reg, &shift);
+		if (tc >= 0)
+			ret = time_const_set(component, tc, shift, val);
+		else
+			ret = regmap_update_bits(tscs42xx->regmap, reg, 0xff,
+				dsp_bypass_filter(tscs42xx, reg, val));
+		if (ret < 0)
+			break;
+	}
+	mutex_unlock(&tscs42xx->bypass_lock);
+
+	return ret < 0 ? ret : 0;
+}
+
+/* Profile for the output DACs DAPM has decided to power, or -1 */
+static int profile_select(struct snd_soc_dapm_context *dapm)
+{
+	struct snd_soc_dapm_widget *w;
+	int idx = -1;
+
+	list_for_each_entry(w, &dapm->card->widgets, list) {
+		if (w->dapm != dapm || w->reg != R_PWRM2 || !w->power)
+			continue;
+		if (w->shift == FB_PWRM2_HPL || w->shift == FB_PWRM2_HPR)
+			return PROFILE_HEADPHONE;
+		if (w->shift == FB_PWRM2_SPKL || w->shift == FB_PWRM2_SPKR)
+			idx = PROFILE_SPEAKER;
+	}
+
+	return idx;
+}
+
+static int profile_update(struct snd_soc_component *component,
+	struct snd_soc_dapm_context *dapm)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	int idx = profile_select(dapm);
+	int ret = 0;
+
+	mutex_lock(&tscs42xx->profile_lock);
+
+	if (idx < 0 || idx == tscs42xx->profile_active ||
+	    !tscs42xx->profiles[idx].size)
+		goto exit;
+
+	ret = profile_apply(component, idx);
+	if (ret < 0) {
+		dev_err(component->dev, "Failed to apply %s profile (%d)\n",
+			idx == PROFILE_HEADPHONE ? "headphone" : "speaker", ret);
+		goto exit;
+	}
+	tscs42xx->profile_active = idx;
+exit:
+	mutex_unlock(&tscs42xx->profile_lock);
+
+	return ret;
+}
+
+static int profile_store(struct snd_soc_component *component, int idx,
+	const u8 *data, unsigned int size)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	struct tscs42xx_profile *profile = &tscs42xx->profiles[idx];
+	int ret;
+
+	/* An empty write clears the profile */
+	if (size) {
+		ret = profile_check(component, data, size);
+		if (ret < 0)
+			return ret;
+	}
+
+	mutex_lock(&tscs42xx->profile_lock);
+
+	memcpy(profile->data, data, size);
+	profile->size = size;
+
+	/* The path in use picks the new profile up right away */
+	ret = 0;
+	if (size && tscs42xx->profile_active == idx)
+		ret = profile_apply(component, idx);
+
+	mutex_unlock(&tscs42xx->profile_lock);
+
+	return ret;
+}
+
+static int profile_tlv_get(struct snd_kcontrol *kcontrol,
+	unsigned int __user *bytes, unsigned int size, int idx)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	struct tscs42xx_profile *profile = &tscs42xx->profiles[idx];
+	struct snd_ctl_tlv hdr = { 0 };
+	int ret = 0;
+
+	mutex_lock(&tscs42xx->profile_lock);
+
+	hdr.length = profile->size;
+	if (size < sizeof(hdr) + profile->size) {
+		ret = -ENOSPC;
+		goto exit;
+	}
+	if (copy_to_user(bytes, &hdr, sizeof(hdr)) ||
+	    copy_to_user(bytes + 2, profile->data, profile->size))
+		ret = -EFAULT;
+exit:
+	mutex_unlock(&tscs42xx->profile_lock);
+
+	return ret;
+}
+
+static int profile_tlv_put(struct snd_kcontrol *kcontrol,
+	const unsigned int __user *bytes, unsigned int size, int idx)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	struct snd_ctl_tlv hdr;
+	u8 *data;
+	int ret;
+
+	if (size < sizeof(hdr))
+		return -EINVAL;
+	if (copy_from_user(&hdr, bytes, sizeof(hdr)))
+		return -EFAULT;
+	if (hdr.length > PROFILE_MAX_SIZE || hdr.length > size - sizeof(hdr))
+		return -EINVAL;
+
+	data = memdup_user(bytes + 2, hdr.length);
+	if (IS_ERR(data))
+		return PTR_ERR(data);
+
+	ret = profile_store(component, idx, data, hdr.length);
+	kfree(data);
+
+	return ret;
+}
+
+static int speaker_profile_get(struct snd_kcontrol *kcontrol,
+	unsigned int __user *bytes, unsigned int size)
+{
+	return profile_tlv_get(kcontrol, bytes, size, PROFILE_SPEAKER);
+}
+
+static int speaker_profile_put(struct snd_kcontrol *kcontrol,
+	const unsigned int __user *bytes, unsigned int size)
+{
+	return profile_tlv_put(kcontrol, bytes, size, PROFILE_SPEAKER);
+}
+
+static int headphone_profile_get(struct snd_kcontrol *kcontrol,
+	unsigned int __user *bytes, unsigned int size)
+{
+	return profile_tlv_get(kcontrol, bytes, size, PROFILE_HEADPHONE);
+}
+
+static int headphone_profile_put(struct snd_kcontrol *kcontrol,
+	const unsigned int __user *bytes, unsigned int size)
+{
+	return profile_tlv_put(kcontrol, bytes, size, PROFILE_HEADPHONE);
+}
+
+static void profile_fw_load(struct snd_soc_component *component, int idx,
+	const char *prop)
+{
+	const struct firmware *fw;
+	const char *name;
+	int ret;
+
+	if (device_property_read_string(component->dev, prop, &name))
+		return;
+
+	ret = request_firmware(&fw, name, component->dev);
+	if (ret < 0) {
+		dev_warn(component->dev, "Failed to load profile %s (%d)\n",
+			name, ret);
+		return;
+	}
+
+	ret = fw->size > PROFILE_MAX_SIZE ? -EINVAL :
+		profile_store(component, idx, fw->data, fw->size);
+	if (ret < 0)
+		dev_warn(component->dev, "Invalid profile %s (%d)\n", name,
+			ret);
+
+	release_firmware(fw);
+}
+
+static void profile_init(struct snd_soc_component *component)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	mutex_init(&tscs42xx->profile_lock);
+	mutex_init(&tscs42xx->state_lock);
+	tscs42xx->profile_active = -1;
+
+	profile_fw_load(component, PROFILE_SPEAKER, "tempo,speaker-profile");
+	profile_fw_load(component, PROFILE_HEADPHONE,
+		"tempo,headphone-profile");
+}
 
-	ret = 0;
-exit:
-	mutex_unlock(&tscs42xx->coeff_ram_lock);
+static int dac_event(struct snd_soc_dapm_widget *w,
+		     struct snd_kcontrol *kcontrol, int event)
+{
+	struct snd_soc_component *component =
+		snd_soc_dapm_to_component(w->dapm);
 
-	return ret;
+	switch (event) {
+	case SND_SOC_DAPM_PRE_PMU:
+	case SND_SOC_DAPM_POST_PMD:
+		return profile_update(component, w->dapm);
+	default:
+		return coeff_ram_flush(component);
+	}
 }
 
 static const struct snd_soc_dapm_widget tscs42xx_dapm_widgets[] = {
@@ -417,19 +3891,23 @@ static const struct snd_soc_dapm_widget tscs42xx_dapm_widgets[] = {
 
 	/* Headphone */
 	SND_SOC_DAPM_DAC_E("DAC L", "HiFi Playback", R_PWRM2, FB_PWRM2_HPL, 0,
-			dac_event, SND_SOC_DAPM_POST_PMU),
+			dac_event, SND_SOC_DAPM_PRE_PMU | SND_SOC_DAPM_POST_PMU |
+			SND_SOC_DAPM_POST_PMD),
 	SND_SOC_DAPM_DAC_E("DAC R", "HiFi Playback", R_PWRM2, FB_PWRM2_HPR, 0,
-			dac_event, SND_SOC_DAPM_POST_PMU),
+			dac_event, SND_SOC_DAPM_PRE_PMU | SND_SOC_DAPM_POST_PMU |
+			SND_SOC_DAPM_POST_PMD),
 	SND_SOC_DAPM_OUTPUT("Headphone L"),
 	SND_SOC_DAPM_OUTPUT("Headphone R"),
 
 	/* Speaker */
 	SND_SOC_DAPM_DAC_E("ClassD L", "HiFi Playback",
 		R_PWRM2, FB_PWRM2_SPKL, 0,
-		dac_event, SND_SOC_DAPM_POST_PMU),
+		dac_event, SND_SOC_DAPM_PRE_PMU | SND_SOC_DAPM_POST_PMU |
+			SND_SOC_DAPM_POST_PMD),
 	SND_SOC_DAPM_DAC_E("ClassD R", "HiFi Playback",
 		R_PWRM2, FB_PWRM2_SPKR, 0,
-		dac_event, SND_SOC_DAPM_POST_PMU),
+		dac_event, SND_SOC_DAPM_PRE_PMU | SND_SOC_DAPM_POST_PMU |
+			SND_SOC_DAPM_POST_PMD),
 	SND_SOC_DAPM_OUTPUT("Speaker L"),
 	SND_SOC_DAPM_OUTPUT("Speaker R"),
 
@@ -448,15 +3926,6 @@ static const struct snd_soc_dapm_widget tscs42xx_dapm_widgets[] = {
 	SND_SOC_DAPM_MUX("Input R Capture Route", R_PWRM2,
 			FB_PWRM2_INSELR, 0, &right_input_select),
 
-	/* Digital Mic */
-	SND_SOC_DAPM_SUPPLY_S("Digital Mic Enable", 2, R_DMICCTL,
-		FB_DMICCTL_DMICEN, 0, NULL,
-		SND_SOC_DAPM_POST_PMU|SND_SOC_DAPM_PRE_PMD),
-
-	/* Analog Mic */
-	SND_SOC_DAPM_SUPPLY_S("Mic Bias", 2, R_PWRM1, FB_PWRM1_MICB,
-		0, dapm_micb_event, SND_SOC_DAPM_POST_PMU|SND_SOC_DAPM_PRE_PMD),
-
 	/* Line In */
 	SND_SOC_DAPM_INPUT("Line In 1 L"),
 	SND_SOC_DAPM_INPUT("Line In 1 R"),
@@ -466,6 +3935,17 @@ static const struct snd_soc_dapm_widget tscs42xx_dapm_widgets[] = {
 	SND_SOC_DAPM_INPUT("Line In 3 R"),
 };
 
+/* Mono capture only needs the left channel, the right path stays off */
+static int capture_stereo(struct snd_soc_dapm_widget *source,
+			  struct snd_soc_dapm_widget *sink)
+{
+	struct snd_soc_component *component =
+		snd_soc_dapm_to_component(source->dapm);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	return !READ_ONCE(tscs42xx->capture_mono);
+}
+
 static const struct snd_soc_dapm_route tscs42xx_intercon[] = {
 	{"DAC L", NULL, "PLL"},
 	{"DAC R", NULL, "PLL"},
@@ -484,8 +3964,6 @@ static const struct snd_soc_dapm_route tscs42xx_intercon[] = {
 	{"Input L Capture Route", NULL, "Vref"},
 	{"Input R Capture Route", NULL, "Vref"},
 
-	{"Mic Bias", NULL, "Vref"},
-
 	{"Input L Capture Route", "Line 1", "Line In 1 L"},
 	{"Input R Capture Route", "Line 1", "Line In 1 R"},
 	{"Input L Capture Route", "Line 2", "Line In 2 L"},
@@ -498,11 +3976,28 @@ static const struct snd_soc_dapm_route tscs42xx_intercon[] = {
 	{"Analog Boost L", NULL, "Analog In PGA L"},
 	{"Analog Boost R", NULL, "Analog In PGA R"},
 	{"ADC Mute", NULL, "Analog Boost L"},
-	{"ADC Mute", NULL, "Analog Boost R"},
+	{"ADC Mute", NULL, "Analog Boost R", capture_stereo},
 	{"ADC L", NULL, "PLL"},
 	{"ADC R", NULL, "PLL"},
 	{"ADC L", NULL, "ADC Mute"},
-	{"ADC R", NULL, "ADC Mute"},
+	{"ADC R", NULL, "ADC Mute", capture_stereo},
+};
+
+/* Analog mic part */
+static const struct snd_soc_dapm_widget tscs42a1_dapm_widgets[] = {
+	SND_SOC_DAPM_SUPPLY_S("Mic Bias", 2, R_PWRM1, FB_PWRM1_MICB,
+		0, dapm_micb_event, SND_SOC_DAPM_POST_PMU|SND_SOC_DAPM_PRE_PMD),
+};
+
+static const struct snd_soc_dapm_route tscs42a1_intercon[] = {
+	{"Mic Bias", NULL, "Vref"},
+};
+
+/* Digital mic part */
+static const struct snd_soc_dapm_widget tscs42a2_dapm_widgets[] = {
+	SND_SOC_DAPM_SUPPLY_S("Digital Mic Enable", 2, R_DMICCTL,
+		FB_DMICCTL_DMICEN, 0, NULL,
+		SND_SOC_DAPM_POST_PMU|SND_SOC_DAPM_PRE_PMD),
 };
 
 /************
@@ -615,6 +4110,13 @@ static int bytes_info_ext(struct snd_kcontrol *kcontrol,
 	return 0;
 }
 
+#define TIME_CONST_CTL(xname, xidx) \
+{	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = xname, \
+	.info = time_const_info, \
+	.get = time_const_get, .put = time_const_put, \
+	.private_value = xidx, \
+}
+
 #define COEFF_RAM_CTL(xname, xcount, xaddr) \
 {	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = xname, \
 	.info = bytes_info_ext, \
@@ -627,12 +4129,15 @@ static int bytes_info_ext(struct snd_kcontrol *kcontrol,
 
 static const struct snd_kcontrol_new tscs42xx_snd_controls[] = {
 	/* Volumes */
-	SOC_DOUBLE_R_TLV("Headphone Volume", R_HPVOLL, R_HPVOLR,
-			FB_HPVOLL, 0x7F, 0, hpvol_scale),
-	SOC_DOUBLE_R_TLV("Speaker Volume", R_SPKVOLL, R_SPKVOLR,
-			FB_SPKVOLL, 0x7F, 0, spkvol_scale),
-	SOC_DOUBLE_R_TLV("Master Volume", R_DACVOLL, R_DACVOLR,
-			FB_DACVOLL, 0xFF, 0, dacvol_scale),
+	SOC_DOUBLE_R_EXT_TLV("Headphone Volume", R_HPVOLL, R_HPVOLR,
+			FB_HPVOLL, 0x7F, 0, snd_soc_get_volsw, volume_put,
+			hpvol_scale),
+	SOC_DOUBLE_R_EXT_TLV("Speaker Volume", R_SPKVOLL, R_SPKVOLR,
+			FB_SPKVOLL, 0x7F, 0, snd_soc_get_volsw, volume_put,
+			spkvol_scale),
+	SOC_DOUBLE_R_EXT_TLV("Master Volume", R_DACVOLL, R_DACVOLR,
+			FB_DACVOLL, 0xFF, 0, snd_soc_get_volsw, volume_put,
+			dacvol_scale),
 	SOC_DOUBLE_R_TLV("PCM Volume", R_ADCVOLL, R_ADCVOLR,
 			FB_ADCVOLL, 0xFF, 0, adcvol_scale),
 	SOC_DOUBLE_R_TLV("Input Volume", R_INVOLL, R_INVOLR,
@@ -646,8 +4151,12 @@ static const struct snd_kcontrol_new tscs42xx_snd_controls[] = {
 	/* Input Channel Map */
 	SOC_ENUM("Input Channel Map", ch_map_select_enum),
 
-	/* Mic Bias */
-	SOC_SINGLE("Mic Bias Boost Switch", 0x71, 0x07, 1, 0),
+	/* DC Removal */
+	SOC_DOUBLE("ADC HPF Switch", R_CNVRTR0,
+			FB_CNVRTR0_ADCHPDL, FB_CNVRTR0_ADCHPDR, 1, 1),
+	SOC_SINGLE("DC Removal Switch", R_CONFIG0, FB_CONFIG0_DC_BYPASS, 1, 1),
+	SOC_ENUM_EXT("DC Removal Corner", dc_coef_sel_enum,
+			dc_coef_sel_get, dc_coef_sel_put),
 
 	/* Headphone Auto Switching */
 	SOC_SINGLE("Headphone Auto Switching Switch",
@@ -690,127 +4199,682 @@ static const struct snd_kcontrol_new tscs42xx_snd_controls[] = {
 	COEFF_RAM_CTL("Cascade2L Prescale", COEFF_SIZE, 0x5f),
 	COEFF_RAM_CTL("Cascade2R Prescale", COEFF_SIZE, 0x7f),
 
-	COEFF_RAM_CTL("Bass Extraction BiQuad1", BIQUAD_SIZE, 0x80),
-	COEFF_RAM_CTL("Bass Extraction BiQuad2", BIQUAD_SIZE, 0x85),
+	COEFF_RAM_CTL("Bass Extraction BiQuad1", BIQUAD_SIZE, 0x80),
+	COEFF_RAM_CTL("Bass Extraction BiQuad2", BIQUAD_SIZE, 0x85),
+
+	COEFF_RAM_CTL("Bass Non Linear Function 1", COEFF_SIZE, 0x8a),
+	COEFF_RAM_CTL("Bass Non Linear Function 2", COEFF_SIZE, 0x8b),
+
+	COEFF_RAM_CTL("Bass Limiter BiQuad", BIQUAD_SIZE, 0x8c),
+
+	COEFF_RAM_CTL("Bass Cut Off BiQuad", BIQUAD_SIZE, 0x91),
+
+	COEFF_RAM_CTL("Bass Mix", COEFF_SIZE, 0x96),
+
+	COEFF_RAM_CTL("Treb Extraction BiQuad1", BIQUAD_SIZE, 0x97),
+	COEFF_RAM_CTL("Treb Extraction BiQuad2", BIQUAD_SIZE, 0x9c),
+
+	COEFF_RAM_CTL("Treb Non Linear Function 1", COEFF_SIZE, 0xa1),
+	COEFF_RAM_CTL("Treb Non Linear Function 2", COEFF_SIZE, 0xa2),
+
+	COEFF_RAM_CTL("Treb Limiter BiQuad", BIQUAD_SIZE, 0xa3),
+
+	COEFF_RAM_CTL("Treb Cut Off BiQuad", BIQUAD_SIZE, 0xa8),
+
+	COEFF_RAM_CTL("Treb Mix", COEFF_SIZE, 0xad),
+
+	COEFF_RAM_CTL("3D", COEFF_SIZE, 0xae),
+
+	COEFF_RAM_CTL("3D Mix", COEFF_SIZE, 0xaf),
+
+	COEFF_RAM_CTL("MBC1 BiQuad1", BIQUAD_SIZE, 0xb0),
+	COEFF_RAM_CTL("MBC1 BiQuad2", BIQUAD_SIZE, 0xb5),
+
+	COEFF_RAM_CTL("MBC2 BiQuad1", BIQUAD_SIZE, 0xba),
+	COEFF_RAM_CTL("MBC2 BiQuad2", BIQUAD_SIZE, 0xbf),
+
+	COEFF_RAM_CTL("MBC3 BiQuad1", BIQUAD_SIZE, 0xc4),
+	COEFF_RAM_CTL("MBC3 BiQuad2", BIQUAD_SIZE, 0xc9),
+
+	/* Loudness */
+	SOC_SINGLE_BOOL_EXT("Loudness Switch", 0, loudness_get, loudness_put),
+
+	/* Parameter ramp */
+	SOC_ENUM_EXT("Ramp Target", ramp_target_enum,
+			ramp_target_get, ramp_target_put),
+	SOC_SINGLE_EXT("Ramp Value", SND_SOC_NOPM, 0, RAMP_VALUE_MAX, 0,
+			ramp_value_get, ramp_value_put),
+	SOC_SINGLE_EXT("Ramp Duration", SND_SOC_NOPM, 0,
+			RAMP_DURATION_MAX_MS, 0,
+			ramp_duration_get, ramp_duration_put),
+	SOC_SINGLE_BOOL_EXT("Ramp Switch", 0, ramp_switch_get, ramp_switch_put),
+
+	/* Output profiles */
+	SND_SOC_BYTES_TLV("Speaker Profile",
+		sizeof(struct snd_ctl_tlv) + PROFILE_MAX_SIZE,
+		speaker_profile_get, speaker_profile_put),
+	SND_SOC_BYTES_TLV("Headphone Profile",
+		sizeof(struct snd_ctl_tlv) + PROFILE_MAX_SIZE,
+		headphone_profile_get, headphone_profile_put),
+
+	/* Low latency DSP bypass */
+	SOC_SINGLE_EXT("DSP Bypass Period", SND_SOC_NOPM, 0,
+			DSP_BYPASS_PERIOD_MAX, 0,
+			dsp_bypass_period_get, dsp_bypass_period_put),
+	SOC_SINGLE_BOOL_EXT("DSP Bypass EQ Switch", DSP_BYPASS_EQ,
+			dsp_bypass_block_get, dsp_bypass_block_put),
+	SOC_SINGLE_BOOL_EXT("DSP Bypass FX Switch", DSP_BYPASS_FX,
+			dsp_bypass_block_get, dsp_bypass_block_put),
+	SOC_SINGLE_BOOL_EXT("DSP Bypass MBC Switch", DSP_BYPASS_MBC,
+			dsp_bypass_block_get, dsp_bypass_block_put),
+
+	/* Scheduled coefficient switch */
+	SOC_SINGLE_BOOL_EXT("Coeff Stage Switch", 0,
+			coeff_stage_get, coeff_stage_put),
+	{
+		.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+		.name = "Coeff Stage Frame",
+		.info = coeff_stage_frame_info,
+		.get = coeff_stage_frame_get,
+		.put = coeff_stage_frame_put,
+	},
+	{
+		.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+		.name = "Coeff Stage Stats",
+		.access = SNDRV_CTL_ELEM_ACCESS_READ |
+			SNDRV_CTL_ELEM_ACCESS_VOLATILE,
+		.info = coeff_stage_stats_info,
+		.get = coeff_stage_stats_get,
+	},
+
+	/* EQ */
+	SOC_SINGLE("EQ1 Switch", R_CONFIG1, FB_CONFIG1_EQ1_EN, 1, 0),
+	SOC_SINGLE("EQ2 Switch", R_CONFIG1, FB_CONFIG1_EQ2_EN, 1, 0),
+	SOC_ENUM("EQ1 Band Enable", eq1_band_enable_enum),
+	SOC_ENUM("EQ2 Band Enable", eq2_band_enable_enum),
+
+	/* CLE */
+	SOC_ENUM("CLE Level Detect",
+		cle_level_detection_enum),
+	SOC_ENUM("CLE Level Detect Win",
+		cle_level_detection_window_enum),
+	SOC_SINGLE("Expander Switch",
+		R_CLECTL, FB_CLECTL_EXP_EN, 1, 0),
+	SOC_SINGLE("Limiter Switch",
+		R_CLECTL, FB_CLECTL_LIMIT_EN, 1, 0),
+	SOC_SINGLE("Comp Switch",
+		R_CLECTL, FB_CLECTL_COMP_EN, 1, 0),
+	SOC_SINGLE_TLV("CLE Make-Up Gain Volume",
+		R_MUGAIN, FB_MUGAIN_CLEMUG, 0x1f, 0, mugain_scale),
+	SOC_SINGLE_TLV("Comp Thresh Volume",
+		R_COMPTH, FB_COMPTH, 0xff, 0, compth_scale),
+	SOC_ENUM("Comp Ratio", compressor_ratio_enum),
+	TIME_CONST_CTL("Comp Atk Time", TIME_CONST_CLE_ATK),
+
+	/* Effects */
+	SOC_SINGLE("3D Switch", R_FXCTL, FB_FXCTL_3DEN, 1, 0),
+	SOC_SINGLE("Treble Switch", R_FXCTL, FB_FXCTL_TEEN, 1, 0),
+	SOC_SINGLE("Treble Bypass Switch", R_FXCTL, FB_FXCTL_TNLFBYPASS, 1, 0),
+	SOC_SINGLE("Bass Switch", R_FXCTL, FB_FXCTL_BEEN, 1, 0),
+	SOC_SINGLE("Bass Bypass Switch", R_FXCTL, FB_FXCTL_BNLFBYPASS, 1, 0),
+
+	/* MBC */
+	SOC_SINGLE("MBC Band1 Switch", R_DACMBCEN, FB_DACMBCEN_MBCEN1, 1, 0),
+	SOC_SINGLE("MBC Band2 Switch", R_DACMBCEN, FB_DACMBCEN_MBCEN2, 1, 0),
+	SOC_SINGLE("MBC Band3 Switch", R_DACMBCEN, FB_DACMBCEN_MBCEN3, 1, 0),
+	SOC_ENUM("MBC Band1 Level Detect",
+		mbc_level_detection_enums[0]),
+	SOC_ENUM("MBC Band2 Level Detect",
+		mbc_level_detection_enums[1]),
+	SOC_ENUM("MBC Band3 Level Detect",
+		mbc_level_detection_enums[2]),
+	SOC_ENUM("MBC Band1 Level Detect Win",
+		mbc_level_detection_window_enums[0]),
+	SOC_ENUM("MBC Band2 Level Detect Win",
+		mbc_level_detection_window_enums[1]),
+	SOC_ENUM("MBC Band3 Level Detect Win",
+		mbc_level_detection_window_enums[2]),
+
+	SOC_SINGLE("MBC1 Phase Invert Switch",
+		R_DACMBCMUG1, FB_DACMBCMUG1_PHASE, 1, 0),
+	SOC_SINGLE_TLV("DAC MBC1 Make-Up Gain Volume",
+		R_DACMBCMUG1, FB_DACMBCMUG1_MUGAIN, 0x1f, 0, mugain_scale),
+	SOC_SINGLE_TLV("DAC MBC1 Comp Thresh Volume",
+		R_DACMBCTHR1, FB_DACMBCTHR1_THRESH, 0xff, 0, compth_scale),
+	SOC_ENUM("DAC MBC1 Comp Ratio",
+		dac_mbc1_compressor_ratio_enum),
+	TIME_CONST_CTL("DAC MBC1 Comp Atk Time", TIME_CONST_MBC1_ATK),
+	TIME_CONST_CTL("DAC MBC1 Comp Rel Time Const",
+		TIME_CONST_MBC1_REL),
+
+	SOC_SINGLE("MBC2 Phase Invert Switch",
+		R_DACMBCMUG2, FB_DACMBCMUG2_PHASE, 1, 0),
+	SOC_SINGLE_TLV("DAC MBC2 Make-Up Gain Volume",
+		R_DACMBCMUG2, FB_DACMBCMUG2_MUGAIN, 0x1f, 0, mugain_scale),
+	SOC_SINGLE_TLV("DAC MBC2 Comp Thresh Volume",
+		R_DACMBCTHR2, FB_DACMBCTHR2_THRESH, 0xff, 0, compth_scale),
+	SOC_ENUM("DAC MBC2 Comp Ratio",
+		dac_mbc2_compressor_ratio_enum),
+	TIME_CONST_CTL("DAC MBC2 Comp Atk Time", TIME_CONST_MBC2_ATK),
+	TIME_CONST_CTL("DAC MBC2 Comp Rel Time Const",
+		TIME_CONST_MBC2_REL),
+
+	SOC_SINGLE("MBC3 Phase Invert Switch",
+		R_DACMBCMUG3, FB_DACMBCMUG3_PHASE, 1, 0),
+	SOC_SINGLE_TLV("DAC MBC3 Make-Up Gain Volume",
+		R_DACMBCMUG3, FB_DACMBCMUG3_MUGAIN, 0x1f, 0, mugain_scale),
+	SOC_SINGLE_TLV("DAC MBC3 Comp Thresh Volume",
+		R_DACMBCTHR3, FB_DACMBCTHR3_THRESH, 0xff, 0, compth_scale),
+	SOC_ENUM("DAC MBC3 Comp Ratio",
+		dac_mbc3_compressor_ratio_enum),
+	TIME_CONST_CTL("DAC MBC3 Comp Atk Time", TIME_CONST_MBC3_ATK),
+	TIME_CONST_CTL("DAC MBC3 Comp Rel Time Const",
+		TIME_CONST_MBC3_REL),
+};
+
+static const struct snd_kcontrol_new tscs42a1_snd_controls[] = {
+	/* Mic Bias */
+	SOC_SINGLE("Mic Bias Boost Switch", 0x71, 0x07, 1, 0),
+};
+
+/*
+ * The common tables carry what both parts have. Each compatible adds only
+ * the mic front end it is built with, so DAPM never sees the other one.
+ */
+struct tscs42xx_variant {
+	const struct snd_soc_dapm_widget *widgets;
+	unsigned int num_widgets;
+	const struct snd_soc_dapm_route *routes;
+	unsigned int num_routes;
+	const struct snd_kcontrol_new *controls;
+	unsigned int num_controls;
+};
+
+static const struct tscs42xx_variant tscs42a1_variant = {
+	.widgets = tscs42a1_dapm_widgets,
+	.num_widgets = ARRAY_SIZE(tscs42a1_dapm_widgets),
+	.routes = tscs42a1_intercon,
+	.num_routes = ARRAY_SIZE(tscs42a1_intercon),
+	.controls = tscs42a1_snd_controls,
+	.num_controls = ARRAY_SIZE(tscs42a1_snd_controls),
+};
+
+static const struct tscs42xx_variant tscs42a2_variant = {
+	.widgets = tscs42a2_dapm_widgets,
+	.num_widgets = ARRAY_SIZE(tscs42a2_dapm_widgets),
+};
+
+static int variant_probe(struct snd_soc_component *component)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	const struct tscs42xx_variant *variant = tscs42xx->variant;
+	struct snd_soc_dapm_context *dapm =
+		snd_soc_component_get_dapm(component);
+	int ret;
+
+	ret = snd_soc_dapm_new_controls(dapm, variant->widgets,
+		variant->num_widgets);
+	if (ret < 0)
+		return ret;
+
+	/* The common widgets are in place, the common routes come later */
+	ret = snd_soc_dapm_add_routes(dapm, variant->routes,
+		variant->num_routes);
+	if (ret < 0)
+		return ret;
+
+	return snd_soc_add_component_controls(component, variant->controls,
+		variant->num_controls);
+}
+
+/*
+ * Power accounting
+ *
+ * After every DAPM power sequence step the power bits below and the
+ * widgets of this component are sampled, accumulating time on and power
+ * up counts. The bits are read from the register cache so this costs no
+ * bus traffic. "tempo,power-microamp" optionally gives a current estimate
+ * per bit, in table order, for a charge estimate. debugfs "power" shows it
+ * all; a block held up while idle stands out by its on time.
+ */
+static const struct power_block {
+	const char *name;
+	unsigned int reg;
+	unsigned int shift;
+} power_blocks[] = {
+	{ "Vref", R_PWRM2, FB_PWRM2_VREF },
+	{ "PLL1", R_PLLCTL1C, FB_PLLCTL1C_PDB_PLL1 },
+	{ "PLL2", R_PLLCTL1C, FB_PLLCTL1C_PDB_PLL2 },
+	{ "HP L", R_PWRM2, FB_PWRM2_HPL },
+	{ "HP R", R_PWRM2, FB_PWRM2_HPR },
+	{ "ClassD L", R_PWRM2, FB_PWRM2_SPKL },
+	{ "ClassD R", R_PWRM2, FB_PWRM2_SPKR },
+	{ "Input Sel L", R_PWRM2, FB_PWRM2_INSELL },
+	{ "Input Sel R", R_PWRM2, FB_PWRM2_INSELR },
+	{ "PGA L", R_PWRM1, FB_PWRM1_PGAL },
+	{ "PGA R", R_PWRM1, FB_PWRM1_PGAR },
+	{ "Boost L", R_PWRM1, FB_PWRM1_BSTL },
+	{ "Boost R", R_PWRM1, FB_PWRM1_BSTR },
+	{ "ADC L", R_PWRM1, FB_PWRM1_ADCL },
+	{ "ADC R", R_PWRM1, FB_PWRM1_ADCR },
+	{ "Mic Bias", R_PWRM1, FB_PWRM1_MICB },
+	{ "DMIC", R_DMICCTL, FB_DMICCTL_DMICEN },
+};
+
+static void power_stat_update(struct power_stat *stat, bool on, u64 now)
+{
+	if (stat->on == on)
+		return;
+
+	if (on)
+		stat->ups++;
+	else
+		stat->on_ns += now - stat->since_ns;
+	stat->on = on;
+	stat->since_ns = now;
+}
+
+static void power_account(struct snd_soc_component *component)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	u64 now = ktime_get_boottime_ns();
+	unsigned int val;
+	int i;
+
+	mutex_lock(&tscs42xx->power_lock);
+
+	for (i = 0; i < ARRAY_SIZE(power_blocks); i++) {
+		if (snd_soc_component_read(component, power_blocks[i].reg,
+				&val) < 0)
+			continue;
+		power_stat_update(&tscs42xx->power_blocks[i],
+			val & BIT(power_blocks[i].shift), now);
+	}
+
+	for (i = 0; i < tscs42xx->num_power_widgets; i++)
+		power_stat_update(&tscs42xx->power_widgets[i],
+			tscs42xx->power_widgets[i].widget->power, now);
+
+	mutex_unlock(&tscs42xx->power_lock);
+}
+
+static void tscs42xx_seq_notifier(struct snd_soc_component *component,
+	enum snd_soc_dapm_type type, int subseq)
+{
+	power_account(component);
+}
+
+static int power_init(struct device *dev, struct tscs42xx *tscs42xx)
+{
+	u32 microamp[ARRAY_SIZE(power_blocks)];
+	int cnt;
+	int i;
+
+	mutex_init(&tscs42xx->power_lock);
+
+	tscs42xx->power_blocks = devm_kcalloc(dev, ARRAY_SIZE(power_blocks),
+		sizeof(*tscs42xx->power_blocks), GFP_KERNEL);
+	if (!tscs42xx->power_blocks)
+		return -ENOMEM;
+
+	cnt = device_property_count_u32(dev, "tempo,power-microamp");
+	if (cnt <= 0)
+		return 0;
+	cnt = min_t(int, cnt, ARRAY_SIZE(power_blocks));
+	if (device_property_read_u32_array(dev, "tempo,power-microamp",
+			microamp, cnt))
+		return 0;
+
+	for (i = 0; i < cnt; i++)
+		tscs42xx->power_blocks[i].microamp = microamp[i];
+
+	return 0;
+}
+
+/* Widgets exist once the component has probed its variant */
+static int power_widgets_init(struct snd_soc_component *component)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	struct snd_soc_dapm_context *dapm =
+		snd_soc_component_get_dapm(component);
+	struct snd_soc_dapm_widget *w;
+	struct power_stat *stats;
+	unsigned int cnt = 0;
+
+	list_for_each_entry(w, &component->card->widgets, list)
+		if (w->dapm == dapm)
+			cnt++;
+
+	stats = kcalloc(cnt, sizeof(*stats), GFP_KERNEL);
+	if (!stats)
+		return -ENOMEM;
+
+	cnt = 0;
+	list_for_each_entry(w, &component->card->widgets, list)
+		if (w->dapm == dapm)
+			stats[cnt++].widget = w;
+
+	mutex_lock(&tscs42xx->power_lock);
+	tscs42xx->power_widgets = stats;
+	tscs42xx->num_power_widgets = cnt;
+	mutex_unlock(&tscs42xx->power_lock);
+
+	return 0;
+}
+
+static void power_widgets_free(struct snd_soc_component *component)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	mutex_lock(&tscs42xx->power_lock);
+	kfree(tscs42xx->power_widgets);
+	tscs42xx->power_widgets = NULL;
+	tscs42xx->num_power_widgets = 0;
+	mutex_unlock(&tscs42xx->power_lock);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static u64 power_stat_on_ns(const struct power_stat *stat, u64 now)
+{
+	return stat->on_ns + (stat->on ? now - stat->since_ns : 0);
+}
+
+static int power_show(struct seq_file *m, void *unused)
+{
+	struct tscs42xx *tscs42xx = m->private;
+	u64 now = ktime_get_boottime_ns();
+	struct power_stat *stat;
+	u64 on_ms;
+	int i;
+
+	mutex_lock(&tscs42xx->power_lock);
+
+	seq_printf(m, "%-24s %3s %8s %12s %8s %10s\n", "block", "on", "ups",
+		"on ms", "uA", "uAh");
+	for (i = 0; i < ARRAY_SIZE(power_blocks); i++) {
+		stat = &tscs42xx->power_blocks[i];
+		on_ms = div_u64(power_stat_on_ns(stat, now), NSEC_PER_MSEC);
+		seq_printf(m, "%-24s %3d %8u %12llu %8u %10llu\n",
+			power_blocks[i].name, stat->on, stat->ups, on_ms,
+			stat->microamp,
+			div_u64(on_ms * stat->microamp, 3600000));
+	}
+
+	seq_printf(m, "\n%-24s %3s %8s %12s\n", "widget", "on", "ups",
+		"on ms");
+	for (i = 0; i < tscs42xx->num_power_widgets; i++) {
+		stat = &tscs42xx->power_widgets[i];
+		seq_printf(m, "%-24s %3d %8u %12llu\n", stat->widget->name,
+			stat->on, stat->ups,
+			div_u64(power_stat_on_ns(stat, now), NSEC_PER_MSEC));
+	}
+
+	mutex_unlock(&tscs42xx->power_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(power);
+
+static void power_debugfs_init(struct snd_soc_component *component)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	debugfs_create_file("power", 0444, component->debugfs_root, tscs42xx,
+		&power_fops);
+}
+#else
+static inline void power_debugfs_init(struct snd_soc_component *component)
+{
+}
+#endif
+
+/*
+ * State checkpoint
+ *
+ * The sysfs binary attribute "state" holds the whole codec configuration
+ * in the layout of the output profiles: a header, the coefficient RAM
+ * image in control byte order and (register, value) pairs for every
+ * cached register. Writing a checkpoint back, in a single write, sends the
+ * registers in one multi register write and the coefficient image in one
+ * upload, so provisioning a unit is one write bounded by bus bandwidth
+ * instead of a control by control restore.
+ *
+ * The power registers, the converter mutes and everything hw_params,
+ * set_fmt and the PLL code program for a stream (interface format, mono
+ * data select, sample rates, DC removal corner, PLL and reference clock
+ * settings) belong to DAPM and the stream callbacks. They are neither
+ * exported nor restored, so applying a checkpoint never reclocks or
+ * reformats a running stream, and the driver's view of the rate stays
+ * true. A checkpoint carries no stream setup of its own. Everything else
+ * goes through the same bookkeeping as its controls: time constants are
+ * 48 kHz references, DSP enables respect a running bypass and the
+ * loudness shelves keep their biquads.
+ */
+static unsigned int state_reg_owned(unsigned int reg)
+{
+	switch (reg) {
+	case R_PWRM1:
+	case R_PWRM2:
+	case R_AIC1:
+	case R_ADCSR:
+	case R_DACSR:
+	case R_DCOFSEL:
+	case R_PLLCTL9 ... R_PLLCTL12:
+	case R_PLLCTL1B:
+	case R_PLLCTL1C:
+	case R_TIMEBASE:
+	case R_PLLREFSEL:
+		return 0xff;
+	case R_AIC2:
+		return RM_AIC2_DACDSEL | RM_AIC2_BLRCM;
+	case R_CNVRTR0:
+		return RM_CNVRTR0_ADCMU;
+	case R_CNVRTR1:
+		return RM_CNVRTR1_DACMU;
+	default:
+		return 0;
+	}
+}
+
+static bool state_reg_valid(struct device *dev, unsigned int reg)
+{
+	return reg <= R_DACMBCREL3H && !tscs42xx_volatile(dev, reg) &&
+		state_reg_owned(reg) != 0xff;
+}
+
+static int state_check(struct device *dev, const u8 *data, size_t size)
+{
+	const struct state_hdr *hdr = (const void *)data;
+	unsigned int num_regs;
+	const u8 *regs;
+	int i;
+
+	if (size < sizeof(*hdr) + COEFF_RAM_SIZE ||
+	    memcmp(hdr->magic, "T42S", sizeof(hdr->magic)) ||
+	    le16_to_cpu(hdr->version) != STATE_VERSION)
+		return -EINVAL;
 
-	COEFF_RAM_CTL("Bass Non Linear Function 1", COEFF_SIZE, 0x8a),
-	COEFF_RAM_CTL("Bass Non Linear Function 2", COEFF_SIZE, 0x8b),
+	num_regs = le16_to_cpu(hdr->num_regs);
+	if (size != sizeof(*hdr) + COEFF_RAM_SIZE + num_regs * 2)
+		return -EINVAL;
 
-	COEFF_RAM_CTL("Bass Limiter BiQuad", BIQUAD_SIZE, 0x8c),
+	regs = data + sizeof(*hdr) + COEFF_RAM_SIZE;
+	for (i = 0; i < num_regs; i++)
+		if (!state_reg_valid(dev, regs[i * 2]))
+			return -EINVAL;
 
-	COEFF_RAM_CTL("Bass Cut Off BiQuad", BIQUAD_SIZE, 0x91),
+	return 0;
+}
 
-	COEFF_RAM_CTL("Bass Mix", COEFF_SIZE, 0x96),
+static ssize_t state_read(struct file *file, struct kobject *kobj,
+	struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	struct device *dev = kobj_to_dev(kobj);
+	struct tscs42xx *tscs42xx = dev_get_drvdata(dev);
+	struct state_hdr *hdr;
+	unsigned int num_regs = 0;
+	unsigned int reg, val, shift;
+	u8 *data, *regs;
+	ssize_t ret;
+	int tc;
+
+	data = kzalloc(STATE_MAX_SIZE, GFP_KERNEL);
+	if (!data)
+		return -ENOMEM;
+
+	hdr = (void *)data;
+	memcpy(hdr->magic, "T42S", sizeof(hdr->magic));
+	hdr->version = cpu_to_le16(STATE_VERSION);
+
+	ret = coeff_ram_read(tscs42xx, 0, data + sizeof(*hdr),
+		COEFF_RAM_COEFF_COUNT);
+	if (ret < 0)
+		goto exit;
 
-	COEFF_RAM_CTL("Treb Extraction BiQuad1", BIQUAD_SIZE, 0x97),
-	COEFF_RAM_CTL("Treb Extraction BiQuad2", BIQUAD_SIZE, 0x9c),
+	/* Only cached registers, reading the rest would go to the bus */
+	regs = data + sizeof(*hdr) + COEFF_RAM_SIZE;
+	for (reg = 0; reg <= R_DACMBCREL3H; reg++) {
+		if (!state_reg_valid(dev, reg) ||
+		    !regmap_cached(tscs42xx->regmap, reg))
+			continue;
+		tc = time_const_idx(reg, &shift);
+		if (tc >= 0) {
+			mutex_lock(&tscs42xx->time_const_lock);
+			val = tscs42xx->time_const[tc] >> shift;
+			mutex_unlock(&tscs42xx->time_const_lock);
+		} else {
+			ret = regmap_read(tscs42xx->regmap, reg, &val);
+			if (ret < 0)
+				goto exit;
+		}
+		regs[num_regs * 2] = reg;
+		regs[num_regs * 2 + 1] = val;
+		num_regs++;
+	}
+	hdr->num_regs = cpu_to_le16(num_regs);
 
-	COEFF_RAM_CTL("Treb Non Linear Function 1", COEFF_SIZE, 0xa1),
-	COEFF_RAM_CTL("Treb Non Linear Function 2", COEFF_SIZE, 0xa2),
+	ret = memory_read_from_buffer(buf, count, &off, data,
+		regs + num_regs * 2 - data);
+exit:
+	kfree(data);
 
-	COEFF_RAM_CTL("Treb Limiter BiQuad", BIQUAD_SIZE, 0xa3),
+	return ret;
+}
 
-	COEFF_RAM_CTL("Treb Cut Off BiQuad", BIQUAD_SIZE, 0xa8),
+static int state_apply_regs(struct tscs42xx *tscs42xx, const u8 *regs,
+	unsigned int num_regs)
+{
+	struct snd_soc_component *component = tscs42xx->component;
+	struct reg_sequence *seq;
+	unsigned int reg, val, shift, owned;
+	int num_seq = 0;
+	int ret = 0;
+	int tc;
+	int i;
 
-	COEFF_RAM_CTL("Treb Mix", COEFF_SIZE, 0xad),
+	seq = kcalloc(num_regs, sizeof(*seq), GFP_KERNEL);
+	if (!seq)
+		return -ENOMEM;
+
+	mutex_lock(&tscs42xx->bypass_lock);
+
+	/* Bits owned by DAPM and the mutes are updated around, not over */
+	for (i = 0; i < num_regs; i++) {
+		reg = regs[i * 2];
+		val = dsp_bypass_filter(tscs42xx, reg, regs[i * 2 + 1]);
+		tc = time_const_idx(reg, &shift);
+		owned = state_reg_owned(reg);
+		if (tc >= 0) {
+			ret = time_const_set(component, tc, shift, val);
+		} else if (owned) {
+			ret = regmap_update_bits(tscs42xx->regmap, reg,
+				0xff & ~owned, val);
+		} else {
+			seq[num_seq].reg = reg;
+			seq[num_seq].def = val;
+			num_seq++;
+		}
+		if (ret < 0)
+			goto exit;
+	}
 
-	COEFF_RAM_CTL("3D", COEFF_SIZE, 0xae),
+	/* The rest goes out in one multi register write */
+	if (num_seq)
+		ret = regmap_multi_reg_write(tscs42xx->regmap, seq, num_seq);
+exit:
+	mutex_unlock(&tscs42xx->bypass_lock);
+	kfree(seq);
 
-	COEFF_RAM_CTL("3D Mix", COEFF_SIZE, 0xaf),
+	if (ret < 0)
+		dev_err(component->dev, "Failed to restore registers (%d)\n",
+			ret);
 
-	COEFF_RAM_CTL("MBC1 BiQuad1", BIQUAD_SIZE, 0xb0),
-	COEFF_RAM_CTL("MBC1 BiQuad2", BIQUAD_SIZE, 0xb5),
+	return ret;
+}
 
-	COEFF_RAM_CTL("MBC2 BiQuad1", BIQUAD_SIZE, 0xba),
-	COEFF_RAM_CTL("MBC2 BiQuad2", BIQUAD_SIZE, 0xbf),
+static int state_apply(struct tscs42xx *tscs42xx, const u8 *data)
+{
+	struct snd_soc_component *component = tscs42xx->component;
+	const struct state_hdr *hdr = (const void *)data;
+	const u8 *coeffs = data + sizeof(*hdr);
+	const u8 *regs = coeffs + COEFF_RAM_SIZE;
+	unsigned int start, end;
+	struct qos_upload up;
+	int ret;
 
-	COEFF_RAM_CTL("MBC3 BiQuad1", BIQUAD_SIZE, 0xc4),
-	COEFF_RAM_CTL("MBC3 BiQuad2", BIQUAD_SIZE, 0xc9),
+	ret = state_apply_regs(tscs42xx, regs, le16_to_cpu(hdr->num_regs));
+	if (ret < 0)
+		return ret;
 
-	/* EQ */
-	SOC_SINGLE("EQ1 Switch", R_CONFIG1, FB_CONFIG1_EQ1_EN, 1, 0),
-	SOC_SINGLE("EQ2 Switch", R_CONFIG1, FB_CONFIG1_EQ2_EN, 1, 0),
-	SOC_ENUM("EQ1 Band Enable", eq1_band_enable_enum),
-	SOC_ENUM("EQ2 Band Enable", eq2_band_enable_enum),
+	/*
+	 * One run unless loudness owns some biquads. Lands in the cache only
+	 * when the PLL is down, see dac_event().
+	 */
+	qos_upload_begin(tscs42xx, &up);
+	for (start = 0; start < COEFF_RAM_COEFF_COUNT; start = end) {
+		for (; start < COEFF_RAM_COEFF_COUNT &&
+		     loudness_owns(tscs42xx, start, 1); start++)
+			;
+		for (end = start; end < COEFF_RAM_COEFF_COUNT &&
+		     !loudness_owns(tscs42xx, end, 1); end++)
+			;
+		if (end == start)
+			continue;
+		ret = coeff_ram_update(component, start,
+			&coeffs[start * COEFF_SIZE], end - start);
+		if (ret < 0)
+			break;
+	}
+	qos_upload_end(tscs42xx, &up);
 
-	/* CLE */
-	SOC_ENUM("CLE Level Detect",
-		cle_level_detection_enum),
-	SOC_ENUM("CLE Level Detect Win",
-		cle_level_detection_window_enum),
-	SOC_SINGLE("Expander Switch",
-		R_CLECTL, FB_CLECTL_EXP_EN, 1, 0),
-	SOC_SINGLE("Limiter Switch",
-		R_CLECTL, FB_CLECTL_LIMIT_EN, 1, 0),
-	SOC_SINGLE("Comp Switch",
-		R_CLECTL, FB_CLECTL_COMP_EN, 1, 0),
-	SOC_SINGLE_TLV("CLE Make-Up Gain Volume",
-		R_MUGAIN, FB_MUGAIN_CLEMUG, 0x1f, 0, mugain_scale),
-	SOC_SINGLE_TLV("Comp Thresh Volume",
-		R_COMPTH, FB_COMPTH, 0xff, 0, compth_scale),
-	SOC_ENUM("Comp Ratio", compressor_ratio_enum),
-	SND_SOC_BYTES("Comp Atk Time", R_CATKTCL, 2),
+	return ret;
+}
 
-	/* Effects */
-	SOC_SINGLE("3D Switch", R_FXCTL, FB_FXCTL_3DEN, 1, 0),
-	SOC_SINGLE("Treble Switch", R_FXCTL, FB_FXCTL_TEEN, 1, 0),
-	SOC_SINGLE("Treble Bypass Switch", R_FXCTL, FB_FXCTL_TNLFBYPASS, 1, 0),
-	SOC_SINGLE("Bass Switch", R_FXCTL, FB_FXCTL_BEEN, 1, 0),
-	SOC_SINGLE("Bass Bypass Switch", R_FXCTL, FB_FXCTL_BNLFBYPASS, 1, 0),
+static ssize_t state_write(struct file *file, struct kobject *kobj,
+	struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	struct device *dev = kobj_to_dev(kobj);
+	struct tscs42xx *tscs42xx = dev_get_drvdata(dev);
+	int ret;
 
-	/* MBC */
-	SOC_SINGLE("MBC Band1 Switch", R_DACMBCEN, FB_DACMBCEN_MBCEN1, 1, 0),
-	SOC_SINGLE("MBC Band2 Switch", R_DACMBCEN, FB_DACMBCEN_MBCEN2, 1, 0),
-	SOC_SINGLE("MBC Band3 Switch", R_DACMBCEN, FB_DACMBCEN_MBCEN3, 1, 0),
-	SOC_ENUM("MBC Band1 Level Detect",
-		mbc_level_detection_enums[0]),
-	SOC_ENUM("MBC Band2 Level Detect",
-		mbc_level_detection_enums[1]),
-	SOC_ENUM("MBC Band3 Level Detect",
-		mbc_level_detection_enums[2]),
-	SOC_ENUM("MBC Band1 Level Detect Win",
-		mbc_level_detection_window_enums[0]),
-	SOC_ENUM("MBC Band2 Level Detect Win",
-		mbc_level_detection_window_enums[1]),
-	SOC_ENUM("MBC Band3 Level Detect Win",
-		mbc_level_detection_window_enums[2]),
+	/* A checkpoint is applied whole or not at all */
+	if (off)
+		return -EINVAL;
 
-	SOC_SINGLE("MBC1 Phase Invert Switch",
-		R_DACMBCMUG1, FB_DACMBCMUG1_PHASE, 1, 0),
-	SOC_SINGLE_TLV("DAC MBC1 Make-Up Gain Volume",
-		R_DACMBCMUG1, FB_DACMBCMUG1_MUGAIN, 0x1f, 0, mugain_scale),
-	SOC_SINGLE_TLV("DAC MBC1 Comp Thresh Volume",
-		R_DACMBCTHR1, FB_DACMBCTHR1_THRESH, 0xff, 0, compth_scale),
-	SOC_ENUM("DAC MBC1 Comp Ratio",
-		dac_mbc1_compressor_ratio_enum),
-	SND_SOC_BYTES("DAC MBC1 Comp Atk Time", R_DACMBCATK1L, 2),
-	SND_SOC_BYTES("DAC MBC1 Comp Rel Time Const",
-		R_DACMBCREL1L, 2),
+	ret = state_check(dev, (const u8 *)buf, count);
+	if (ret < 0)
+		return ret;
 
-	SOC_SINGLE("MBC2 Phase Invert Switch",
-		R_DACMBCMUG2, FB_DACMBCMUG2_PHASE, 1, 0),
-	SOC_SINGLE_TLV("DAC MBC2 Make-Up Gain Volume",
-		R_DACMBCMUG2, FB_DACMBCMUG2_MUGAIN, 0x1f, 0, mugain_scale),
-	SOC_SINGLE_TLV("DAC MBC2 Comp Thresh Volume",
-		R_DACMBCTHR2, FB_DACMBCTHR2_THRESH, 0xff, 0, compth_scale),
-	SOC_ENUM("DAC MBC2 Comp Ratio",
-		dac_mbc2_compressor_ratio_enum),
-	SND_SOC_BYTES("DAC MBC2 Comp Atk Time", R_DACMBCATK2L, 2),
-	SND_SOC_BYTES("DAC MBC2 Comp Rel Time Const",
-		R_DACMBCREL2L, 2),
+	mutex_lock(&tscs42xx->state_lock);
+	ret = state_apply(tscs42xx, (const u8 *)buf);
+	mutex_unlock(&tscs42xx->state_lock);
+	if (ret < 0)
+		return ret;
 
-	SOC_SINGLE("MBC3 Phase Invert Switch",
-		R_DACMBCMUG3, FB_DACMBCMUG3_PHASE, 1, 0),
-	SOC_SINGLE_TLV("DAC MBC3 Make-Up Gain Volume",
-		R_DACMBCMUG3, FB_DACMBCMUG3_MUGAIN, 0x1f, 0, mugain_scale),
-	SOC_SINGLE_TLV("DAC MBC3 Comp Thresh Volume",
-		R_DACMBCTHR3, FB_DACMBCTHR3_THRESH, 0xff, 0, compth_scale),
-	SOC_ENUM("DAC MBC3 Comp Ratio",
-		dac_mbc3_compressor_ratio_enum),
-	SND_SOC_BYTES("DAC MBC3 Comp Atk Time", R_DACMBCATK3L, 2),
-	SND_SOC_BYTES("DAC MBC3 Comp Rel Time Const",
-		R_DACMBCREL3L, 2),
-};
+	return count;
+}
+
+static BIN_ATTR_RW(state, 0);
 
 static int setup_sample_format(struct snd_soc_component *component,
 		snd_pcm_format_t format)
@@ -900,41 +4964,37 @@ static int setup_sample_rate(struct snd_soc_component *component,
 		return -EINVAL;
 	}
 
-	/* DAC and ADC share bit and frame clock */
-	ret = snd_soc_component_update_bits(component,
-			R_DACSR, RM_DACSR_DBR, br);
-	if (ret < 0) {
-		dev_err(component->dev,
-				"Failed to update register (%d)\n", ret);
-		return ret;
-	}
-	ret = snd_soc_component_update_bits(component,
-			R_DACSR, RM_DACSR_DBM, bm);
-	if (ret < 0) {
-		dev_err(component->dev,
-				"Failed to update register (%d)\n", ret);
-		return ret;
-	}
-	ret = snd_soc_component_update_bits(component,
-			R_ADCSR, RM_DACSR_DBR, br);
+	/*
+	 * DAC and ADC share bit and frame clock. Queued async, the PLL
+	 * power up waits for them.
+	 */
+	ret = snd_soc_component_update_bits_async(component,
+			R_DACSR, RM_DACSR_DBR | RM_DACSR_DBM, br | bm);
 	if (ret < 0) {
 		dev_err(component->dev,
 				"Failed to update register (%d)\n", ret);
 		return ret;
 	}
-	ret = snd_soc_component_update_bits(component,
-			R_ADCSR, RM_DACSR_DBM, bm);
+	ret = snd_soc_component_update_bits_async(component,
+			R_ADCSR, RM_DACSR_DBR | RM_DACSR_DBM, br | bm);
 	if (ret < 0) {
 		dev_err(component->dev,
 				"Failed to update register (%d)\n", ret);
 		return ret;
 	}
 
-	mutex_lock(&tscs42xx->audio_params_lock);
+	WRITE_ONCE(tscs42xx->samplerate, rate);
+
+	ret = dc_coef_update(component);
+	if (ret < 0)
+		return ret;
 
-	tscs42xx->samplerate = rate;
+	ret = time_const_update(component, rate);
+	if (ret < 0)
+		return ret;
 
-	mutex_unlock(&tscs42xx->audio_params_lock);
+	/* Shelves are designed per rate family */
+	loudness_schedule(tscs42xx);
 
 	return 0;
 }
@@ -1044,48 +5104,268 @@ static const struct pll_ctl pll_ctls[] = {
 		0x23, 0x10, 0x05, 0x05, 0x98, 0x04),
 };
 
-static const struct pll_ctl *get_pll_ctl(int input_freq)
-{
-	int i;
-	const struct pll_ctl *pll_ctl = NULL;
+static const struct pll_ctl *get_pll_ctl(int input_freq)
+{
+	int i;
+	const struct pll_ctl *pll_ctl = NULL;
+
+	for (i = 0; i < ARRAY_SIZE(pll_ctls); ++i)
+		if (input_freq == pll_ctls[i].input_freq) {
+			pll_ctl = &pll_ctls[i];
+			break;
+		}
+
+	return pll_ctl;
+}
+
+/*
+ * Settings owned by each PLL. The timebase divider and the first R_PLLCTL1B
+ * nibble go with PLL1, the second R_PLLCTL1B nibble with PLL2.
+ */
+static const struct {
+	int first;
+	int last;
+} pll_settings[] = {
+	{ 0, 6 },	/* R_TIMEBASE, R_PLLCTLD, R_PLLCTL1B[3:0], R_PLLCTL9-C */
+	{ 7, 12 },	/* R_PLLCTL12, R_PLLCTL1B[7:4], R_PLLCTLE-11 */
+};
+
+static int set_pll_ctl_from_input_freq(struct snd_soc_component *component,
+		int pll, const int input_freq)
+{
+	int ret;
+	int i;
+	const struct pll_ctl *pll_ctl;
+
+	pll_ctl = get_pll_ctl(input_freq);
+	if (!pll_ctl) {
+		ret = -EINVAL;
+		dev_err(component->dev, "No PLL input entry for %d (%d)\n",
+			input_freq, ret);
+		return ret;
+	}
+
+	/* Queued async, the PLL power up waits for them */
+	for (i = pll_settings[pll].first; i <= pll_settings[pll].last; ++i) {
+		ret = snd_soc_component_update_bits_async(component,
+			pll_ctl->settings[i].addr,
+			pll_ctl->settings[i].mask,
+			pll_ctl->settings[i].val);
+		if (ret < 0) {
+			dev_err(component->dev, "Failed to set pll ctl (%d)\n",
+				ret);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Pre-warm
+ *
+ * Vref settle, PLL lock and the coefficient flush would otherwise run
+ * back to back when DAPM powers up at prepare. Opening a stream starts
+ * Vref in the background and hw_params adds the PLL for the rate family
+ * and the flush, so DAPM finds them already up. The pins are held until
+ * the last stream is closed. startup/shutdown are serialized by the card
+ * pcm_mutex, which also covers warm_users.
+ */
+static void warm_work(struct work_struct *work)
+{
+	struct tscs42xx *tscs42xx =
+		container_of(work, struct tscs42xx, warm_work);
+	struct snd_soc_component *component = tscs42xx->component;
+	struct snd_soc_dapm_context *dapm =
+		snd_soc_component_get_dapm(component);
+	u8 path = journal_path_push(tscs42xx, JOURNAL_PATH_WORK);
+	int freq;
+	int ret;
+
+	snd_soc_component_force_enable_pin(component, "Vref");
+
+	if (READ_ONCE(tscs42xx->warm_pll)) {
+		freq = sample_rate_to_pll_freq_out(
+			READ_ONCE(tscs42xx->samplerate));
+		/* A PLL warmed for the other rate family has to restart */
+		if (tscs42xx->warm_pll_freq && tscs42xx->warm_pll_freq != freq) {
+			snd_soc_component_disable_pin(component, "PLL");
+			snd_soc_dapm_sync(dapm);
+		}
+		tscs42xx->warm_pll_freq = freq;
+		snd_soc_component_force_enable_pin(component, "PLL");
+	}
+
+	snd_soc_dapm_sync(dapm);
+
+	if (READ_ONCE(tscs42xx->warm_pll) && pll_is_locked(component)) {
+		ret = coeff_ram_flush(component);
+		if (ret < 0)
+			dev_err(component->dev,
+				"Failed to pre-warm coeff ram (%d)\n", ret);
+	}
+
+	journal_path_pop(tscs42xx, path);
+}
+
+static int tscs42xx_startup(struct snd_pcm_substream *substream,
+		struct snd_soc_dai *dai)
+{
+	struct tscs42xx *tscs42xx =
+		snd_soc_component_get_drvdata(dai->component);
+
+	if (tscs42xx->warm_users++ == 0)
+		queue_work(system_highpri_wq, &tscs42xx->warm_work);
+
+	return 0;
+}
+
+static void tscs42xx_shutdown(struct snd_pcm_substream *substream,
+		struct snd_soc_dai *dai)
+{
+	struct snd_soc_component *component = dai->component;
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	/* The stream is muted by now, make sure it reached the chip */
+	flush_work(&tscs42xx->mute_work);
+	qos_stream_put(tscs42xx, substream->stream);
+
+	if (--tscs42xx->warm_users)
+		return;
+
+	flush_work(&tscs42xx->warm_work);
+
+	WRITE_ONCE(tscs42xx->warm_pll, false);
+	tscs42xx->warm_pll_freq = 0;
+	snd_soc_component_disable_pin(component, "PLL");
+	snd_soc_component_disable_pin(component, "Vref");
+	snd_soc_dapm_sync(snd_soc_component_get_dapm(component));
+}
+
+/*
+ * Mono streams are handled in the codec instead of by host side channel
+ * conversion. Mono playback copies the left slot to the right DAC, so
+ * both outputs carry the stream at full level whatever the CPU DAI puts
+ * in the second slot. Mono capture powers down the right ADC, PGA and
+ * boost and the CPU DAI takes the left slot.
+ *
+ * The DMONOMIX/AMONOMIX mixers are not used: they average left and right,
+ * which is 6 dB low with an empty second slot or an unpowered right path,
+ * and the field has no documented left only setting.
+ */
+static int setup_channels(struct snd_soc_component *component,
+		int stream, unsigned int channels)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	bool mono = channels == 1;
+	int ret;
+
+	if (stream == SNDRV_PCM_STREAM_PLAYBACK) {
+		ret = snd_soc_component_update_bits(component, R_AIC2,
+			RM_AIC2_DACDSEL, mono ?
+			RV_AIC2_DACDSEL_LEFT_TO_RIGHT :
+			RV_AIC2_DACDSEL_NORMAL);
+		if (ret < 0) {
+			dev_err(component->dev,
+				"Failed to set DAC channel map (%d)\n", ret);
+			return ret;
+		}
+		return 0;
+	}
+
+	if (READ_ONCE(tscs42xx->capture_mono) != mono) {
+		WRITE_ONCE(tscs42xx->capture_mono, mono);
+		/* Stream start at prepare re-evaluates the capture paths */
+		snd_soc_dapm_mark_endpoints_dirty(component->card);
+	}
+
+	return 0;
+}
+
+static int set_bclk_ratio(struct snd_soc_component *component,
+		unsigned int ratio)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	unsigned int value;
+	int ret = 0;
+
+	switch (ratio) {
+	case 32:
+		value = RV_DACSR_DBCM_32;
+		break;
+	case 40:
+		value = RV_DACSR_DBCM_40;
+		break;
+	case 64:
+		value = RV_DACSR_DBCM_64;
+		break;
+	default:
+		dev_err(component->dev, "Unsupported bclk ratio (%d)\n", ret);
+		return -EINVAL;
+	}
+
+	ret = snd_soc_component_update_bits(component,
+			R_DACSR, RM_DACSR_DBCM, value);
+	if (ret < 0) {
+		dev_err(component->dev,
+				"Failed to set DAC BCLK ratio (%d)\n", ret);
+		return ret;
+	}
+	ret = snd_soc_component_update_bits(component,
+			R_ADCSR, RM_ADCSR_ABCM, value);
+	if (ret < 0) {
+		dev_err(component->dev,
+				"Failed to set ADC BCLK ratio (%d)\n", ret);
+		return ret;
+	}
 
-	for (i = 0; i < ARRAY_SIZE(pll_ctls); ++i)
-		if (input_freq == pll_ctls[i].input_freq) {
-			pll_ctl = &pll_ctls[i];
-			break;
-		}
+	WRITE_ONCE(tscs42xx->bclk_ratio, ratio);
 
-	return pll_ctl;
+	return 0;
 }
 
-static int set_pll_ctl_from_input_freq(struct snd_soc_component *component,
-		const int input_freq)
+/*
+ * Without a ratio from the machine driver use the smallest one that fits
+ * two slots. The slot is the TDM slot width when one was set, otherwise
+ * the physical sample width, which is what CPU DAIs put on the wire. The
+ * CPU DAI is asked first and the codec only follows if it agrees; most
+ * CPU DAIs cannot change the ratio, in which case the current one stays.
+ */
+static int setup_auto_bclk_ratio(struct snd_pcm_substream *substream,
+		struct snd_pcm_hw_params *params,
+		struct snd_soc_component *component)
 {
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	struct snd_soc_pcm_runtime *rtd = substream->private_data;
+	unsigned int slot = READ_ONCE(tscs42xx->slot_width);
+	unsigned int ratio;
 	int ret;
-	int i;
-	const struct pll_ctl *pll_ctl;
 
-	pll_ctl = get_pll_ctl(input_freq);
-	if (!pll_ctl) {
-		ret = -EINVAL;
-		dev_err(component->dev, "No PLL input entry for %d (%d)\n",
-			input_freq, ret);
-		return ret;
-	}
+	if (READ_ONCE(tscs42xx->bclk_ratio_fixed))
+		return 0;
 
-	for (i = 0; i < PLL_REG_SETTINGS_COUNT; ++i) {
-		ret = snd_soc_component_update_bits(component,
-			pll_ctl->settings[i].addr,
-			pll_ctl->settings[i].mask,
-			pll_ctl->settings[i].val);
-		if (ret < 0) {
-			dev_err(component->dev, "Failed to set pll ctl (%d)\n",
-				ret);
-			return ret;
-		}
+	if (!slot)
+		slot = max(params_width(params), params_physical_width(params));
+
+	if (slot <= 16)
+		ratio = 32;
+	else if (slot <= 20)
+		ratio = 40;
+	else
+		ratio = 64;
+
+	if (ratio == READ_ONCE(tscs42xx->bclk_ratio))
+		return 0;
+
+	ret = snd_soc_dai_set_bclk_ratio(asoc_rtd_to_cpu(rtd, 0), ratio);
+	if (ret < 0) {
+		dev_dbg(component->dev,
+			"CPU DAI did not take bclk ratio %u (%d), keeping current\n",
+			ratio, ret);
+		return 0;
 	}
 
-	return 0;
+	return set_bclk_ratio(component, ratio);
 }
 
 static int tscs42xx_hw_params(struct snd_pcm_substream *substream,
@@ -1093,23 +5373,68 @@ static int tscs42xx_hw_params(struct snd_pcm_substream *substream,
 		struct snd_soc_dai *codec_dai)
 {
 	struct snd_soc_component *component = codec_dai->component;
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	u8 path = journal_path_push(tscs42xx, JOURNAL_PATH_HW_PARAMS);
+	unsigned int period;
 	int ret;
 
+	io_begin(tscs42xx, IO_CRITICAL);
+	qos_stream_get(tscs42xx, substream->stream);
+
 	ret = setup_sample_format(component, params_format(params));
 	if (ret < 0) {
 		dev_err(component->dev, "Failed to setup sample format (%d)\n",
 			ret);
-		return ret;
+		goto exit;
 	}
 
 	ret = setup_sample_rate(component, params_rate(params));
 	if (ret < 0) {
 		dev_err(component->dev,
 				"Failed to setup sample rate (%d)\n", ret);
-		return ret;
+		goto exit;
 	}
 
-	return 0;
+	ret = setup_channels(component, substream->stream,
+		params_channels(params));
+	if (ret < 0)
+		goto exit;
+
+	ret = setup_auto_bclk_ratio(substream, params, component);
+	if (ret < 0)
+		goto exit;
+
+	WRITE_ONCE(tscs42xx->warm_pll, true);
+	queue_work(system_highpri_wq, &tscs42xx->warm_work);
+
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
+		period = READ_ONCE(tscs42xx->bypass_period);
+		ret = dsp_bypass_update(component,
+			params_period_size(params) < period);
+		if (ret < 0)
+			goto exit;
+	}
+
+	ret = 0;
+exit:
+	io_end(tscs42xx, IO_CRITICAL);
+	journal_path_pop(tscs42xx, path);
+
+	return ret;
+}
+
+static int tscs42xx_hw_free(struct snd_pcm_substream *substream,
+		struct snd_soc_dai *codec_dai)
+{
+	struct tscs42xx *tscs42xx =
+		snd_soc_component_get_drvdata(codec_dai->component);
+
+	qos_stream_put(tscs42xx, substream->stream);
+
+	if (substream->stream != SNDRV_PCM_STREAM_PLAYBACK)
+		return 0;
+
+	return dsp_bypass_update(codec_dai->component, false);
 }
 
 static inline int dac_mute(struct snd_soc_component *component)
@@ -1174,23 +5499,53 @@ static inline int adc_unmute(struct snd_soc_component *component)
 	return 0;
 }
 
-static int tscs42xx_mute_stream(struct snd_soc_dai *dai, int mute, int stream)
+/*
+ * Mute changes are applied from a high priority work item so the PCM core
+ * never waits on the bus. A mute is queued right away. An unmute is only
+ * armed and queued at trigger start so it lands close to the first
+ * sample. mute_want and unmute_armed hold one bit per stream direction.
+ */
+static void mute_work(struct work_struct *work)
 {
-	struct snd_soc_component *component = dai->component;
-	int ret;
+	struct tscs42xx *tscs42xx =
+		container_of(work, struct tscs42xx, mute_work);
+	struct snd_soc_component *component = tscs42xx->component;
+	u8 path = journal_path_push(tscs42xx, JOURNAL_PATH_MUTE);
+
+	io_begin(tscs42xx, IO_CRITICAL);
+
+	if (test_bit(SNDRV_PCM_STREAM_PLAYBACK, &tscs42xx->mute_want)) {
+		dac_mute(component);
+	} else {
+		dac_unmute(component);
+		qos_stream_put(tscs42xx, SNDRV_PCM_STREAM_PLAYBACK);
+	}
 
-	if (mute)
-		if (stream == SNDRV_PCM_STREAM_PLAYBACK)
-			ret = dac_mute(component);
-		else
-			ret = adc_mute(component);
-	else
-		if (stream == SNDRV_PCM_STREAM_PLAYBACK)
-			ret = dac_unmute(component);
-		else
-			ret = adc_unmute(component);
+	if (test_bit(SNDRV_PCM_STREAM_CAPTURE, &tscs42xx->mute_want)) {
+		adc_mute(component);
+	} else {
+		adc_unmute(component);
+		qos_stream_put(tscs42xx, SNDRV_PCM_STREAM_CAPTURE);
+	}
 
-	return ret;
+	io_end(tscs42xx, IO_CRITICAL);
+	journal_path_pop(tscs42xx, path);
+}
+
+static int tscs42xx_mute_stream(struct snd_soc_dai *dai, int mute, int stream)
+{
+	struct tscs42xx *tscs42xx =
+		snd_soc_component_get_drvdata(dai->component);
+
+	if (mute) {
+		clear_bit(stream, &tscs42xx->unmute_armed);
+		set_bit(stream, &tscs42xx->mute_want);
+		queue_work(system_highpri_wq, &tscs42xx->mute_work);
+	} else {
+		set_bit(stream, &tscs42xx->unmute_armed);
+	}
+
+	return 0;
 }
 
 static int tscs42xx_set_dai_fmt(struct snd_soc_dai *codec_dai,
@@ -1224,53 +5579,89 @@ static int tscs42xx_set_dai_bclk_ratio(struct snd_soc_dai *codec_dai,
 {
 	struct snd_soc_component *component = codec_dai->component;
 	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
-	unsigned int value;
-	int ret = 0;
+	int ret;
 
-	switch (ratio) {
-	case 32:
-		value = RV_DACSR_DBCM_32;
-		break;
-	case 40:
-		value = RV_DACSR_DBCM_40;
+	ret = set_bclk_ratio(component, ratio);
+	if (ret < 0)
+		return ret;
+
+	/* The machine driver owns the ratio from now on */
+	WRITE_ONCE(tscs42xx->bclk_ratio_fixed, true);
+
+	return 0;
+}
+
+static int tscs42xx_trigger(struct snd_pcm_substream *substream, int cmd,
+		struct snd_soc_dai *dai)
+{
+	struct tscs42xx *tscs42xx =
+		snd_soc_component_get_drvdata(dai->component);
+	int stream = substream->stream;
+	bool playback = stream == SNDRV_PCM_STREAM_PLAYBACK;
+
+	switch (cmd) {
+	case SNDRV_PCM_TRIGGER_START:
+	case SNDRV_PCM_TRIGGER_RESUME:
+	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
+		if (test_and_clear_bit(stream, &tscs42xx->unmute_armed)) {
+			clear_bit(stream, &tscs42xx->mute_want);
+			queue_work(system_highpri_wq, &tscs42xx->mute_work);
+		}
+		if (playback)
+			coeff_sched_stream(&tscs42xx->sched, substream);
 		break;
-	case 64:
-		value = RV_DACSR_DBCM_64;
+	case SNDRV_PCM_TRIGGER_STOP:
+	case SNDRV_PCM_TRIGGER_SUSPEND:
+	case SNDRV_PCM_TRIGGER_PAUSE_PUSH:
+		/* Restarts don't go through prepare, re-arm the unmute */
+		if (!test_and_set_bit(stream, &tscs42xx->mute_want)) {
+			set_bit(stream, &tscs42xx->unmute_armed);
+			queue_work(system_highpri_wq, &tscs42xx->mute_work);
+		}
+		if (playback)
+			coeff_sched_stream(&tscs42xx->sched, NULL);
 		break;
-	default:
-		dev_err(component->dev, "Unsupported bclk ratio (%d)\n", ret);
-		return -EINVAL;
 	}
 
-	ret = snd_soc_component_update_bits(component,
-			R_DACSR, RM_DACSR_DBCM, value);
-	if (ret < 0) {
-		dev_err(component->dev,
-				"Failed to set DAC BCLK ratio (%d)\n", ret);
-		return ret;
-	}
-	ret = snd_soc_component_update_bits(component,
-			R_ADCSR, RM_ADCSR_ABCM, value);
-	if (ret < 0) {
-		dev_err(component->dev,
-				"Failed to set ADC BCLK ratio (%d)\n", ret);
-		return ret;
-	}
+	return 0;
+}
 
-	mutex_lock(&tscs42xx->audio_params_lock);
+/* Only two slot frames; the width is used by setup_auto_bclk_ratio() */
+static int tscs42xx_set_dai_tdm_slot(struct snd_soc_dai *codec_dai,
+		unsigned int tx_mask, unsigned int rx_mask, int slots,
+		int slot_width)
+{
+	struct tscs42xx *tscs42xx =
+		snd_soc_component_get_drvdata(codec_dai->component);
+
+	if (slots > 2)
+		return -EINVAL;
 
-	tscs42xx->bclk_ratio = ratio;
+	switch (slot_width) {
+	case 0:
+	case 16:
+	case 20:
+	case 32:
+		break;
+	default:
+		return -EINVAL;
+	}
 
-	mutex_unlock(&tscs42xx->audio_params_lock);
+	WRITE_ONCE(tscs42xx->slot_width, slots ? slot_width : 0);
 
 	return 0;
 }
 
 static const struct snd_soc_dai_ops tscs42xx_dai_ops = {
+	.startup	= tscs42xx_startup,
+	.shutdown	= tscs42xx_shutdown,
 	.hw_params	= tscs42xx_hw_params,
+	.hw_free	= tscs42xx_hw_free,
+	.trigger	= tscs42xx_trigger,
 	.mute_stream	= tscs42xx_mute_stream,
 	.set_fmt	= tscs42xx_set_dai_fmt,
 	.set_bclk_ratio = tscs42xx_set_dai_bclk_ratio,
+	.set_tdm_slot	= tscs42xx_set_dai_tdm_slot,
 };
 
 static int part_is_valid(struct tscs42xx *tscs42xx)
@@ -1302,42 +5693,41 @@ static int part_is_valid(struct tscs42xx *tscs42xx)
 static int set_sysclk(struct snd_soc_component *component)
 {
 	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	unsigned int refsel = 0;
 	unsigned long freq;
 	int ret;
-
-	switch (tscs42xx->sysclk_src_id) {
-	case TSCS42XX_PLL_SRC_XTAL:
-	case TSCS42XX_PLL_SRC_MCLK1:
-		ret = snd_soc_component_write(component, R_PLLREFSEL,
-				RV_PLLREFSEL_PLL1_REF_SEL_XTAL_MCLK1 |
-				RV_PLLREFSEL_PLL2_REF_SEL_XTAL_MCLK1);
-		if (ret < 0) {
-			dev_err(component->dev,
-				"Failed to set pll reference input (%d)\n",
-				ret);
-			return ret;
+	int pll;
+
+	for (pll = 0; pll < ARRAY_SIZE(tscs42xx->sysclk); pll++) {
+		switch (tscs42xx->sysclk_src_id[pll]) {
+		case TSCS42XX_PLL_SRC_XTAL:
+		case TSCS42XX_PLL_SRC_MCLK1:
+			refsel |= pll ? RV_PLLREFSEL_PLL2_REF_SEL_XTAL_MCLK1 :
+				RV_PLLREFSEL_PLL1_REF_SEL_XTAL_MCLK1;
+			break;
+		case TSCS42XX_PLL_SRC_MCLK2:
+			refsel |= pll ? RV_PLLREFSEL_PLL2_REF_SEL_MCLK2 :
+				RV_PLLREFSEL_PLL1_REF_SEL_MCLK2;
+			break;
+		default:
+			dev_err(component->dev, "pll src is unsupported\n");
+			return -EINVAL;
 		}
-		break;
-	case TSCS42XX_PLL_SRC_MCLK2:
-		ret = snd_soc_component_write(component, R_PLLREFSEL,
-				RV_PLLREFSEL_PLL1_REF_SEL_MCLK2 |
-				RV_PLLREFSEL_PLL2_REF_SEL_MCLK2);
+
+		freq = clk_get_rate(tscs42xx->sysclk[pll]);
+		ret = set_pll_ctl_from_input_freq(component, pll, freq);
 		if (ret < 0) {
 			dev_err(component->dev,
-				"Failed to set PLL reference (%d)\n", ret);
+				"Failed to setup PLL%d input freq (%d)\n",
+				pll + 1, ret);
 			return ret;
 		}
-		break;
-	default:
-		dev_err(component->dev, "pll src is unsupported\n");
-		return -EINVAL;
 	}
 
-	freq = clk_get_rate(tscs42xx->sysclk);
-	ret = set_pll_ctl_from_input_freq(component, freq);
+	ret = snd_soc_component_write(component, R_PLLREFSEL, refsel);
 	if (ret < 0) {
 		dev_err(component->dev,
-			"Failed to setup PLL input freq (%d)\n", ret);
+			"Failed to set PLL reference (%d)\n", ret);
 		return ret;
 	}
 
@@ -1346,11 +5736,82 @@ static int set_sysclk(struct snd_soc_component *component)
 
 static int tscs42xx_probe(struct snd_soc_component *component)
 {
-	return set_sysclk(component);
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+	u8 path = journal_path_push(tscs42xx, JOURNAL_PATH_PROBE);
+	int ret;
+
+	group_attach(tscs42xx, component);
+	journal_debugfs_init(component);
+
+	ret = variant_probe(component);
+	if (ret < 0) {
+		dev_err(component->dev, "Failed to add mic widgets (%d)\n", ret);
+		goto exit;
+	}
+
+	ret = power_widgets_init(component);
+	if (ret < 0) {
+		dev_err(component->dev,
+			"Failed to set up power accounting (%d)\n", ret);
+		goto exit;
+	}
+	power_debugfs_init(component);
+	qos_debugfs_init(component);
+	io_debugfs_init(component);
+
+	profile_init(component);
+
+	/* Capture runs with the ADC high pass and DC removal by default */
+	ret = snd_soc_component_update_bits(component, R_CNVRTR0,
+		RM_CNVRTR0_ADCHPDL | RM_CNVRTR0_ADCHPDR,
+		RV_CNVRTR0_ADCHPDL_DISABLE | RV_CNVRTR0_ADCHPDR_DISABLE);
+	if (ret < 0) {
+		dev_err(component->dev, "Failed to enable ADC HPF (%d)\n", ret);
+		goto exit;
+	}
+	ret = snd_soc_component_update_bits(component, R_CONFIG0,
+		RM_CONFIG0_DC_BYPASS, RV_CONFIG0_DC_BYPASS_DISABLE);
+	if (ret < 0) {
+		dev_err(component->dev,
+			"Failed to enable DC removal (%d)\n", ret);
+		goto exit;
+	}
+
+	ret = set_sysclk(component);
+	if (ret < 0)
+		goto exit;
+
+	ret = device_create_bin_file(component->dev, &bin_attr_state);
+	if (ret < 0)
+		dev_err(component->dev,
+			"Failed to add state attribute (%d)\n", ret);
+exit:
+	journal_path_pop(tscs42xx, path);
+
+	return ret;
+}
+
+static void tscs42xx_remove(struct snd_soc_component *component)
+{
+	struct tscs42xx *tscs42xx = snd_soc_component_get_drvdata(component);
+
+	device_remove_bin_file(component->dev, &bin_attr_state);
+	ramp_cancel(&tscs42xx->ramp);
+	cancel_delayed_work_sync(&tscs42xx->loudness_work);
+	coeff_sched_cancel(&tscs42xx->sched);
+	cancel_work_sync(&tscs42xx->warm_work);
+	cancel_work_sync(&tscs42xx->mute_work);
+	cancel_delayed_work_sync(&tscs42xx->qos_timeout);
+	qos_stream_put(tscs42xx, SNDRV_PCM_STREAM_PLAYBACK);
+	qos_stream_put(tscs42xx, SNDRV_PCM_STREAM_CAPTURE);
+	power_widgets_free(component);
+	group_attach(tscs42xx, NULL);
 }
 
 static const struct snd_soc_component_driver soc_codec_dev_tscs42xx = {
 	.probe			= tscs42xx_probe,
+	.remove			= tscs42xx_remove,
+	.seq_notifier		= tscs42xx_seq_notifier,
 	.dapm_widgets		= tscs42xx_dapm_widgets,
 	.num_dapm_widgets	= ARRAY_SIZE(tscs42xx_dapm_widgets),
 	.dapm_routes		= tscs42xx_intercon,
@@ -1359,7 +5820,7 @@ static const struct snd_soc_component_driver soc_codec_dev_tscs42xx = {
 	.num_controls		= ARRAY_SIZE(tscs42xx_snd_controls),
 };
 
-static inline void init_coeff_ram_cache(struct tscs42xx *tscs42xx)
+static int init_coeff_ram_cache(struct tscs42xx *tscs42xx)
 {
 	static const u8 norm_addrs[] = {
 		0x00, 0x05, 0x0a, 0x0f, 0x14, 0x19, 0x1f, 0x20, 0x25, 0x2a,
@@ -1368,11 +5829,20 @@ static inline void init_coeff_ram_cache(struct tscs42xx *tscs42xx)
 		0x8c, 0x91, 0x96, 0x97, 0x9c, 0xa3, 0xa8, 0xad, 0xaf, 0xb0,
 		0xb5, 0xba, 0xbf, 0xc4, 0xc9,
 	};
-	u8 *coeff_ram = tscs42xx->coeff_ram;
 	int i;
+	int ret;
+
+	/* Power on contents are unknown, the first sync writes it all */
+	regcache_cache_only(tscs42xx->coeff_regmap, true);
+	for (i = 0; i < ARRAY_SIZE(norm_addrs); i++) {
+		ret = regmap_write(tscs42xx->coeff_regmap, norm_addrs[i],
+			0x400000);
+		if (ret < 0)
+			return ret;
+	}
+	coeff_ram_mark_dirty(tscs42xx, 0, COEFF_RAM_MAX_ADDR);
 
-	for (i = 0; i < ARRAY_SIZE(norm_addrs); i++)
-		coeff_ram[((norm_addrs[i] + 1) * COEFF_SIZE) - 1] = 0x40;
+	return 0;
 }
 
 #define TSCS42XX_RATES SNDRV_PCM_RATE_8000_96000
@@ -1384,13 +5854,13 @@ static struct snd_soc_dai_driver tscs42xx_dai = {
 	.name = "tscs42xx-HiFi",
 	.playback = {
 		.stream_name = "HiFi Playback",
-		.channels_min = 2,
+		.channels_min = 1,
 		.channels_max = 2,
 		.rates = TSCS42XX_RATES,
 		.formats = TSCS42XX_FORMATS,},
 	.capture = {
 		.stream_name = "HiFi Capture",
-		.channels_min = 2,
+		.channels_min = 1,
 		.channels_max = 2,
 		.rates = TSCS42XX_RATES,
 		.formats = TSCS42XX_FORMATS,},
@@ -1407,11 +5877,62 @@ static const struct reg_sequence tscs42xx_patch[] = {
 static char const * const src_names[TSCS42XX_PLL_SRC_CNT] = {
 	"xtal", "mclk1", "mclk2"};
 
+/*
+ * One reference clock feeds both PLLs. With two, the one on MCLK2 and the
+ * one on XTAL/MCLK1 each feed the PLL of their own rate family, so both
+ * families run from exact references.
+ */
+static int get_sysclks(struct device *dev, struct tscs42xx *tscs42xx)
+{
+	struct clk *clk;
+	int cnt = 0;
+	int src;
+	int ret;
+
+	for (src = TSCS42XX_PLL_SRC_XTAL; src < TSCS42XX_PLL_SRC_CNT; src++) {
+		clk = devm_clk_get(dev, src_names[src]);
+		if (IS_ERR(clk)) {
+			if (PTR_ERR(clk) == -ENOENT)
+				continue;
+			ret = PTR_ERR(clk);
+			dev_err(dev, "Failed to get sysclk (%d)\n", ret);
+			return ret;
+		}
+		if (cnt == ARRAY_SIZE(tscs42xx->sysclk) ||
+		    (cnt && src != TSCS42XX_PLL_SRC_MCLK2)) {
+			ret = -EINVAL;
+			dev_err(dev, "xtal and mclk1 share a PLL input (%d)\n",
+				ret);
+			return ret;
+		}
+		tscs42xx->sysclk[cnt] = clk;
+		tscs42xx->sysclk_src_id[cnt] = src;
+		cnt++;
+	}
+
+	if (!cnt) {
+		ret = -EINVAL;
+		dev_err(dev, "Failed to get a valid clock name (%d)\n", ret);
+		return ret;
+	}
+
+	if (cnt == 1) {
+		tscs42xx->sysclk[1] = tscs42xx->sysclk[0];
+		tscs42xx->sysclk_src_id[1] = tscs42xx->sysclk_src_id[0];
+	} else if (!(clk_get_rate(tscs42xx->sysclk[0]) % 11025) &&
+		   clk_get_rate(tscs42xx->sysclk[1]) % 11025) {
+		/* PLL2 makes the 44.1k family, give it the 44.1k multiple */
+		swap(tscs42xx->sysclk[0], tscs42xx->sysclk[1]);
+		swap(tscs42xx->sysclk_src_id[0], tscs42xx->sysclk_src_id[1]);
+	}
+
+	return 0;
+}
+
 static int tscs42xx_i2c_probe(struct i2c_client *i2c,
 		const struct i2c_device_id *id)
 {
 	struct tscs42xx *tscs42xx;
-	int src;
 	int ret;
 
 	tscs42xx = devm_kzalloc(&i2c->dev, sizeof(*tscs42xx), GFP_KERNEL);
@@ -1422,33 +5943,42 @@ static int tscs42xx_i2c_probe(struct i2c_client *i2c,
 		return ret;
 	}
 	i2c_set_clientdata(i2c, tscs42xx);
+	tscs42xx->journal.path = JOURNAL_PATH_PROBE;
 
-	for (src = TSCS42XX_PLL_SRC_XTAL; src < TSCS42XX_PLL_SRC_CNT; src++) {
-		tscs42xx->sysclk = devm_clk_get(&i2c->dev, src_names[src]);
-		if (!IS_ERR(tscs42xx->sysclk)) {
-			break;
-		} else if (PTR_ERR(tscs42xx->sysclk) != -ENOENT) {
-			ret = PTR_ERR(tscs42xx->sysclk);
-			dev_err(&i2c->dev, "Failed to get sysclk (%d)\n", ret);
-			return ret;
-		}
-	}
-	if (src == TSCS42XX_PLL_SRC_CNT) {
-		ret = -EINVAL;
-		dev_err(&i2c->dev, "Failed to get a valid clock name (%d)\n",
-				ret);
+	tscs42xx->variant = device_get_match_data(&i2c->dev);
+	if (!tscs42xx->variant)
+		tscs42xx->variant =
+			(const struct tscs42xx_variant *)id->driver_data;
+
+	ret = get_sysclks(&i2c->dev, tscs42xx);
+	if (ret < 0)
 		return ret;
-	}
-	tscs42xx->sysclk_src_id = src;
 
-	tscs42xx->regmap = devm_regmap_init_i2c(i2c, &tscs42xx_regmap);
+	if (journal_entries)
+		tscs42xx->regmap = journal_regmap_init(i2c, tscs42xx);
+	else
+		tscs42xx->regmap = devm_regmap_init_i2c(i2c, &tscs42xx_regmap);
 	if (IS_ERR(tscs42xx->regmap)) {
 		ret = PTR_ERR(tscs42xx->regmap);
 		dev_err(&i2c->dev, "Failed to allocate regmap (%d)\n", ret);
 		return ret;
 	}
 
-	init_coeff_ram_cache(tscs42xx);
+	tscs42xx->coeff_regmap = devm_regmap_init(&i2c->dev, &coeff_bus,
+		tscs42xx, &tscs42xx_coeff_regmap);
+	if (IS_ERR(tscs42xx->coeff_regmap)) {
+		ret = PTR_ERR(tscs42xx->coeff_regmap);
+		dev_err(&i2c->dev, "Failed to allocate coeff regmap (%d)\n",
+			ret);
+		return ret;
+	}
+
+	ret = init_coeff_ram_cache(tscs42xx);
+	if (ret < 0) {
+		dev_err(&i2c->dev, "Failed to init coeff ram cache (%d)\n",
+			ret);
+		return ret;
+	}
 
 	ret = part_is_valid(tscs42xx);
 	if (ret <= 0) {
@@ -1470,8 +6000,46 @@ static int tscs42xx_i2c_probe(struct i2c_client *i2c,
 		return ret;
 	}
 
-	mutex_init(&tscs42xx->audio_params_lock);
 	mutex_init(&tscs42xx->coeff_ram_lock);
+	mutex_init(&tscs42xx->qos_lock);
+	INIT_DELAYED_WORK(&tscs42xx->qos_timeout, qos_timeout);
+	io_init(&tscs42xx->io);
+
+	ret = power_init(&i2c->dev, tscs42xx);
+	if (ret < 0) {
+		dev_err(&i2c->dev,
+			"Failed to set up power accounting (%d)\n", ret);
+		return ret;
+	}
+
+	ret = time_const_init(tscs42xx);
+	if (ret < 0) {
+		dev_err(&i2c->dev, "Failed to read time constants (%d)\n",
+			ret);
+		return ret;
+	}
+	mutex_init(&tscs42xx->loudness_lock);
+	INIT_DELAYED_WORK(&tscs42xx->loudness_work, loudness_work);
+	coeff_sched_init(&tscs42xx->sched);
+	ramp_init(&tscs42xx->ramp);
+	INIT_WORK(&tscs42xx->warm_work, warm_work);
+	INIT_WORK(&tscs42xx->mute_work, mute_work);
+	tscs42xx->mute_want = BIT(SNDRV_PCM_STREAM_PLAYBACK) |
+		BIT(SNDRV_PCM_STREAM_CAPTURE);
+
+	mutex_init(&tscs42xx->bypass_lock);
+	tscs42xx->bypass_blocks = BIT(DSP_BYPASS_EQ) | BIT(DSP_BYPASS_FX) |
+		BIT(DSP_BYPASS_MBC);
+	device_property_read_u32(&i2c->dev, "tempo,dsp-bypass-period",
+		&tscs42xx->bypass_period);
+	tscs42xx->bypass_period = min_t(unsigned int,
+		tscs42xx->bypass_period, DSP_BYPASS_PERIOD_MAX);
+
+	ret = group_link(&i2c->dev, tscs42xx);
+	if (ret < 0) {
+		dev_err(&i2c->dev, "Failed to join codec group (%d)\n", ret);
+		return ret;
+	}
 	mutex_init(&tscs42xx->pll_lock);
 
 	ret = devm_snd_soc_register_component(&i2c->dev,
@@ -1481,19 +6049,21 @@ static int tscs42xx_i2c_probe(struct i2c_client *i2c,
 		return ret;
 	}
 
+	journal_path_pop(tscs42xx, JOURNAL_PATH_OTHER);
+
 	return 0;
 }
 
 static const struct i2c_device_id tscs42xx_i2c_id[] = {
-	{ "tscs42A1", 0 },
-	{ "tscs42A2", 0 },
+	{ "tscs42A1", (kernel_ulong_t)&tscs42a1_variant },
+	{ "tscs42A2", (kernel_ulong_t)&tscs42a2_variant },
 	{ }
 };
 MODULE_DEVICE_TABLE(i2c, tscs42xx_i2c_id);
 
 static const struct of_device_id tscs42xx_of_match[] = {
-	{ .compatible = "tempo,tscs42A1", },
-	{ .compatible = "tempo,tscs42A2", },
+	{ .compatible = "tempo,tscs42A1", .data = &tscs42a1_variant },
+	{ .compatible = "tempo,tscs42A2", .data = &tscs42a2_variant },
 	{ }
 };
 MODULE_DEVICE_TABLE(of, tscs42xx_of_match);
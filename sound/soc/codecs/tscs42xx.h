@@ -605,6 +605,8 @@ enum {
 #define FM_AIC2_BLRCM                        0X7
 
 /* Field Values */
+#define FV_AIC2_DACDSEL_NORMAL               0x0
+#define FV_AIC2_DACDSEL_LEFT_TO_RIGHT        0x1
 #define FV_AIC2_BLRCM_DAC_BCLK_LRCLK_SHARED  0x3
 
 /* Register Masks */
@@ -618,6 +620,12 @@ enum {
 #define RM_AIC2_BLRCM                        RM(FM_AIC2_BLRCM, FB_AIC2_BLRCM)
 
 /* Register Values */
+#define RV_AIC2_DACDSEL_NORMAL \
+	 RV(FV_AIC2_DACDSEL_NORMAL, FB_AIC2_DACDSEL)
+
+#define RV_AIC2_DACDSEL_LEFT_TO_RIGHT \
+	 RV(FV_AIC2_DACDSEL_LEFT_TO_RIGHT, FB_AIC2_DACDSEL)
+
 #define RV_AIC2_BLRCM_DAC_BCLK_LRCLK_SHARED \
 	 RV(FV_AIC2_BLRCM_DAC_BCLK_LRCLK_SHARED, FB_AIC2_BLRCM)
 
@@ -649,6 +657,8 @@ enum {
 #define FV_CNVRTR0_ADCPOLR_NORMAL            0x0
 #define FV_CNVRTR0_ADCPOLL_INVERT            0x1
 #define FV_CNVRTR0_ADCPOLL_NORMAL            0x0
+#define FV_CNVRTR0_AMONOMIX_ENABLE           0x1
+#define FV_CNVRTR0_AMONOMIX_DISABLE          0x0
 #define FV_CNVRTR0_ADCMU_ENABLE              0x1
 #define FV_CNVRTR0_ADCMU_DISABLE             0x0
 #define FV_CNVRTR0_ADCHPDR_ENABLE            0x1
@@ -692,6 +702,12 @@ enum {
 #define RV_CNVRTR0_ADCPOLL_NORMAL \
 	 RV(FV_CNVRTR0_ADCPOLL_NORMAL, FB_CNVRTR0_ADCPOLL)
 
+#define RV_CNVRTR0_AMONOMIX_ENABLE \
+	 RV(FV_CNVRTR0_AMONOMIX_ENABLE, FB_CNVRTR0_AMONOMIX)
+
+#define RV_CNVRTR0_AMONOMIX_DISABLE \
+	 RV(FV_CNVRTR0_AMONOMIX_DISABLE, FB_CNVRTR0_AMONOMIX)
+
 #define RV_CNVRTR0_ADCMU_ENABLE \
 	 RV(FV_CNVRTR0_ADCMU_ENABLE, FB_CNVRTR0_ADCMU)
 
@@ -0,0 +1,175 @@
+#!/bin/bash
+
+card='0'
+device='0'
+threads=4
+duration=30
+work_dir=''
+
+options=':c:p:n:t:h'
+
+usage_str="$(basename "$0") [-h] [-c card] [-p device] [-n threads] [-t seconds] -- Stresses the TSCS42xx driver
+
+where:
+    -h  show this help text
+    -c  set the ALSA card index or name
+    -p  set the PCM device on the card
+    -n  set the number of control writer threads
+    -t  set the test duration in seconds
+
+Runs control writers (volumes, coefficient RAM, enums) alongside
+playback open/hw_params/close cycles that alternate between the 44.1k
+and 48k rate families. Reports throughput, max control latency and,
+when the kernel has CONFIG_LOCK_STAT, contention on the driver locks.
+Lockdep splats and hung task reports logged during the run are listed."
+
+usage() { echo "$usage_str"; }
+
+while getopts $options opt; do
+    case ${opt} in
+    c )
+        card="${OPTARG}"
+        ;;
+    p )
+        device="${OPTARG}"
+        ;;
+    n )
+        threads="${OPTARG}"
+        ;;
+    t )
+        duration="${OPTARG}"
+        ;;
+    h )
+        usage; exit 0;
+        ;;
+    \? )
+        echo -e "\n *** Error: Unrecognized argument -$OPTARG\n" >&2; usage; exit 1;
+        ;;
+    : )
+        echo -e "\n *** Error: Missing argument for -$OPTARG\n" >&2; usage; exit 1;
+        ;;
+    esac
+done
+
+for tool in amixer aplay; do
+    if ! command -v $tool > /dev/null; then
+        echo -e "\n *** Error: $tool not found (install alsa-utils)\n" >&2; exit 1;
+    fi
+done
+
+work_dir="$(mktemp -d)"
+trap 'rm -rf "$work_dir"' EXIT
+
+now_ns() { date +%s%N; }
+
+random_bytes() {
+    local count=$1
+    local bytes=()
+    local i
+
+    for ((i = 0; i < count; i++)); do
+        bytes+=($((RANDOM % 256)))
+    done
+    (IFS=,; echo "${bytes[*]}")
+}
+
+random_control() {
+    case $((RANDOM % 8)) in
+    0 ) echo "Master Volume" "$((RANDOM % 256)),$((RANDOM % 256))" ;;
+    1 ) echo "Headphone Volume" "$((RANDOM % 128)),$((RANDOM % 128))" ;;
+    2 ) echo "Speaker Volume" "$((RANDOM % 128)),$((RANDOM % 128))" ;;
+    3 ) echo "EQ1 Band Enable" "$((RANDOM % 7))" ;;
+    4 ) echo "Comp Ratio" "$((RANDOM % 20 + 1))" ;;
+    5 ) echo "Cascade1L BiQuad$((RANDOM % 6 + 1))" "$(random_bytes 15)" ;;
+    6 ) echo "MBC$((RANDOM % 3 + 1)) BiQuad$((RANDOM % 2 + 1))" "$(random_bytes 15)" ;;
+    7 ) echo "Cascade2R Prescale" "$(random_bytes 3)" ;;
+    esac
+}
+
+control_worker() {
+    local id=$1
+    local end=$2
+    local out="$work_dir/ctl.$id"
+    local line name value start
+
+    while [ "$(date +%s)" -lt "$end" ]; do
+        line="$(random_control)"
+        name="${line% *}"
+        value="${line##* }"
+        start=$(now_ns)
+        amixer -q -c "$card" cset name="$name" "$value" > /dev/null 2>&1 \
+            || echo "err" >> "$out"
+        echo $(( $(now_ns) - start )) >> "$out"
+    done
+}
+
+stream_worker() {
+    local end=$1
+    local out="$work_dir/pcm"
+    local rates=(44100 48000)
+    local i=0
+    local rate start
+
+    while [ "$(date +%s)" -lt "$end" ]; do
+        rate=${rates[$((i++ % 2))]}
+        start=$(now_ns)
+        # 100ms of silence: open, hw_params, prepare, start, drain, close
+        head -c $((rate / 10 * 4)) /dev/zero | \
+            aplay -q -D "hw:$card,$device" -t raw -f S16_LE -c 2 -r "$rate" \
+            > /dev/null 2>&1 || echo "err" >> "$out"
+        echo $(( $(now_ns) - start )) >> "$out"
+    done
+}
+
+summarize() {
+    local label=$1
+    shift
+
+    cat "$@" 2>/dev/null | awk -v label="$label" -v secs="$duration" '
+        $1 == "err" { err++; next }
+        { n++; sum += $1; if ($1 > max) max = $1 }
+        END {
+            if (n == 0) { printf "%-10s no samples\n", label; exit }
+            printf "%-10s %8d ops %8.1f ops/s avg %8.3f ms max %8.3f ms errors %d\n",
+                label, n, n / secs, sum / n / 1e6, max / 1e6, err
+        }'
+}
+
+dmesg_start=$(dmesg 2>/dev/null | wc -l)
+
+lock_stat=false
+if [ -w /proc/lock_stat ]; then
+    lock_stat=true
+    echo 0 > /proc/lock_stat
+fi
+
+echo "Card $card device $device: $threads control threads for ${duration}s"
+
+end=$(( $(date +%s) + duration ))
+pids=()
+for ((t = 0; t < threads; t++)); do
+    control_worker $t $end &
+    pids+=($!)
+done
+stream_worker $end &
+pids+=($!)
+wait "${pids[@]}"
+
+summarize "controls" "$work_dir"/ctl.*
+summarize "streams" "$work_dir/pcm"
+
+if [ "$lock_stat" = true ]; then
+    echo
+    echo "Lock contention (/proc/lock_stat):"
+    head -n 4 /proc/lock_stat | tail -n 2
+    grep -E 'coeff_ram_lock|pll_lock|regmap' /proc/lock_stat \
+        | grep ':' | head -n 20
+else
+    echo
+    echo "lock_stat unavailable (needs CONFIG_LOCK_STAT and root)"
+fi
+
+echo
+echo "Lockdep reports during run:"
+dmesg 2>/dev/null | tail -n +$((dmesg_start + 1)) \
+    | grep -E 'WARNING: possible|INFO: task .* blocked' || echo "none"
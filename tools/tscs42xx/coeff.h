@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: GPL-2.0
+// coeff.h -- TSCS42xx coefficient RAM image helpers
+// Copyright 2017 Tempo Semiconductor, Inc.
+
+#ifndef __TSCS42XX_COEFF_H__
+#define __TSCS42XX_COEFF_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * The image layout matches tscs42xx->coeff_ram in the driver: one 24 bit
+ * coefficient per RAM address, stored little endian as written to
+ * DACCRWRL/M/H.
+ *
+ * Coefficients are two's complement with 22 fractional bits, so unity is
+ * 0x400000 (the value the driver preloads into every b0 and prescale) and
+ * the range is [-2.0, 2.0).
+ *
+ * A biquad is five consecutive coefficients b0, b1, b2, a1, a2 for
+ *	y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+ *
+ * "make check" runs a hand built image (tests/biquad.img) through
+ * tscs42xx-eqpreview and compares the impulse response with values worked
+ * out from this layout and equation.
+ */
+
+#define COEFF_SIZE 3
+#define BIQUAD_COEFF_COUNT 5
+#define COEFF_RAM_MAX_ADDR 0xcd
+#define COEFF_RAM_COEFF_COUNT (COEFF_RAM_MAX_ADDR + 1)
+#define COEFF_RAM_SIZE (COEFF_SIZE * COEFF_RAM_COEFF_COUNT)
+
+#define COEFF_FRAC_BITS 22
+#define COEFF_ONE (1 << COEFF_FRAC_BITS)
+#define COEFF_MAX 0x7fffff
+#define COEFF_MIN (-0x800000)
+
+/* EQ cascades: six biquads followed by a prescale at the last address */
+#define CASCADE_BIQUAD_COUNT 6
+#define CASCADE1L_ADDR 0x00
+#define CASCADE1R_ADDR 0x20
+#define CASCADE2L_ADDR 0x40
+#define CASCADE2R_ADDR 0x60
+#define CASCADE_PRESCALE_OFFSET 0x1f
+
+/* Multiband compressor crossovers: two biquads per band */
+#define MBC_BAND_COUNT 3
+#define MBC1_ADDR 0xb0
+#define MBC2_ADDR 0xba
+#define MBC3_ADDR 0xc4
+
+/* R_CONFIG1 */
+#define R_CONFIG1 0x20
+#define CONFIG1_EQ2_EN (1 << 7)
+#define CONFIG1_EQ2_BE(v) (((v) >> 4) & 0x7)
+#define CONFIG1_EQ1_EN (1 << 3)
+#define CONFIG1_EQ1_BE(v) ((v) & 0x7)
+
+struct coeff_ctl {
+	const char *name;
+	unsigned int addr;
+	unsigned int count;
+};
+
+/* Mirrors the driver's COEFF_RAM_CTL() table */
+static const struct coeff_ctl coeff_ctls[] = {
+	{ "Cascade1L BiQuad1", 0x00, 5 },
+	{ "Cascade1L BiQuad2", 0x05, 5 },
+	{ "Cascade1L BiQuad3", 0x0a, 5 },
+	{ "Cascade1L BiQuad4", 0x0f, 5 },
+	{ "Cascade1L BiQuad5", 0x14, 5 },
+	{ "Cascade1L BiQuad6", 0x19, 5 },
+	{ "Cascade1R BiQuad1", 0x20, 5 },
+	{ "Cascade1R BiQuad2", 0x25, 5 },
+	{ "Cascade1R BiQuad3", 0x2a, 5 },
+	{ "Cascade1R BiQuad4", 0x2f, 5 },
+	{ "Cascade1R BiQuad5", 0x34, 5 },
+	{ "Cascade1R BiQuad6", 0x39, 5 },
+	{ "Cascade1L Prescale", 0x1f, 1 },
+	{ "Cascade1R Prescale", 0x3f, 1 },
+	{ "Cascade2L BiQuad1", 0x40, 5 },
+	{ "Cascade2L BiQuad2", 0x45, 5 },
+	{ "Cascade2L BiQuad3", 0x4a, 5 },
+	{ "Cascade2L BiQuad4", 0x4f, 5 },
+	{ "Cascade2L BiQuad5", 0x54, 5 },
+	{ "Cascade2L BiQuad6", 0x59, 5 },
+	{ "Cascade2R BiQuad1", 0x60, 5 },
+	{ "Cascade2R BiQuad2", 0x65, 5 },
+	{ "Cascade2R BiQuad3", 0x6a, 5 },
+	{ "Cascade2R BiQuad4", 0x6f, 5 },
+	{ "Cascade2R BiQuad5", 0x74, 5 },
+	{ "Cascade2R BiQuad6", 0x79, 5 },
+	{ "Cascade2L Prescale", 0x5f, 1 },
+	{ "Cascade2R Prescale", 0x7f, 1 },
+	{ "Bass Extraction BiQuad1", 0x80, 5 },
+	{ "Bass Extraction BiQuad2", 0x85, 5 },
+	{ "Bass Non Linear Function 1", 0x8a, 1 },
+	{ "Bass Non Linear Function 2", 0x8b, 1 },
+	{ "Bass Limiter BiQuad", 0x8c, 5 },
+	{ "Bass Cut Off BiQuad", 0x91, 5 },
+	{ "Bass Mix", 0x96, 1 },
+	{ "Treb Extraction BiQuad1", 0x97, 5 },
+	{ "Treb Extraction BiQuad2", 0x9c, 5 },
+	{ "Treb Non Linear Function 1", 0xa1, 1 },
+	{ "Treb Non Linear Function 2", 0xa2, 1 },
+	{ "Treb Limiter BiQuad", 0xa3, 5 },
+	{ "Treb Cut Off BiQuad", 0xa8, 5 },
+	{ "Treb Mix", 0xad, 1 },
+	{ "3D", 0xae, 1 },
+	{ "3D Mix", 0xaf, 1 },
+	{ "MBC1 BiQuad1", 0xb0, 5 },
+	{ "MBC1 BiQuad2", 0xb5, 5 },
+	{ "MBC2 BiQuad1", 0xba, 5 },
+	{ "MBC2 BiQuad2", 0xbf, 5 },
+	{ "MBC3 BiQuad1", 0xc4, 5 },
+	{ "MBC3 BiQuad2", 0xc9, 5 },
+};
+
+static inline int32_t coeff_get(const uint8_t *ram, unsigned int addr)
+{
+	const uint8_t *c = &ram[addr * COEFF_SIZE];
+	int32_t val = c[0] | (c[1] << 8) | (c[2] << 16);
+
+	/* Sign extend from 24 bits */
+	return (val ^ 0x800000) - 0x800000;
+}
+
+static inline void coeff_put(uint8_t *ram, unsigned int addr, int32_t val)
+{
+	uint8_t *c = &ram[addr * COEFF_SIZE];
+
+	c[0] = val & 0xff;
+	c[1] = (val >> 8) & 0xff;
+	c[2] = (val >> 16) & 0xff;
+}
+
+/* Same defaults as init_coeff_ram_cache() in the driver */
+static inline void coeff_ram_init(uint8_t *ram)
+{
+	static const uint8_t norm_addrs[] = {
+		0x00, 0x05, 0x0a, 0x0f, 0x14, 0x19, 0x1f, 0x20, 0x25, 0x2a,
+		0x2f, 0x34, 0x39, 0x3f, 0x40, 0x45, 0x4a, 0x4f, 0x54, 0x59,
+		0x5f, 0x60, 0x65, 0x6a, 0x6f, 0x74, 0x79, 0x7f, 0x80, 0x85,
+		0x8c, 0x91, 0x96, 0x97, 0x9c, 0xa3, 0xa8, 0xad, 0xaf, 0xb0,
+		0xb5, 0xba, 0xbf, 0xc4, 0xc9,
+	};
+	unsigned int i;
+
+	for (i = 0; i < COEFF_RAM_SIZE; i++)
+		ram[i] = 0;
+	for (i = 0; i < sizeof(norm_addrs); i++)
+		coeff_put(ram, norm_addrs[i], COEFF_ONE);
+}
+
+static inline int coeff_ram_load(const char *path, uint8_t *ram)
+{
+	FILE *f;
+	size_t n;
+
+	f = fopen(path, "rb");
+	if (!f)
+		return -1;
+	n = fread(ram, 1, COEFF_RAM_SIZE, f);
+	fclose(f);
+
+	return n == COEFF_RAM_SIZE ? 0 : -1;
+}
+
+#endif /* __TSCS42XX_COEFF_H__ */
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: GPL-2.0
+// journal.h -- TSCS42xx bus journal format
+// Copyright 2017 Tempo Semiconductor, Inc.
+
+#ifndef __TSCS42XX_JOURNAL_H__
+#define __TSCS42XX_JOURNAL_H__
+
+#include <stdint.h>
+
+/*
+ * The layout matches struct journal_header and struct journal_entry in
+ * the driver, as dumped by the debugfs "journal" file: a header followed
+ * by count entries, oldest first, all fields little endian. dropped is
+ * the number of older entries the ring had already overwritten.
+ *
+ * An entry covers up to four consecutive registers starting at reg,
+ * longer transfers are split over several entries sharing ts_ns.
+ */
+
+#define JOURNAL_MAGIC "T42J"
+#define JOURNAL_VERSION 1
+
+#define JOURNAL_READ 0x01
+#define JOURNAL_ERR 0x02
+
+enum {
+	JOURNAL_PATH_OTHER,
+	JOURNAL_PATH_PROBE,
+	JOURNAL_PATH_HW_PARAMS,
+	JOURNAL_PATH_DAPM,
+	JOURNAL_PATH_COEFF,
+	JOURNAL_PATH_MUTE,
+	JOURNAL_PATH_WORK,
+	JOURNAL_PATH_COUNT,
+};
+
+static const char * const journal_path_names[JOURNAL_PATH_COUNT] = {
+	"other", "probe", "hw_params", "dapm", "coeff", "mute", "work",
+};
+
+struct journal_header {
+	char magic[4];
+	uint16_t version;
+	uint16_t entry_size;
+	uint32_t count;
+	uint32_t dropped;
+} __attribute__((packed));
+
+struct journal_entry {
+	uint64_t ts_ns;
+	uint32_t dur_ns;
+	uint8_t reg;
+	uint8_t len;
+	uint8_t path;
+	uint8_t flags;
+	uint8_t val[4];
+} __attribute__((packed));
+
+/* Registers whose reads legitimately differ from the last write */
+static inline int journal_reg_volatile(uint8_t reg)
+{
+	return (reg >= 0x3a && reg <= 0x40) ||	/* coefficient RAM window */
+		reg == 0x8a ||			/* DACCRSTAT */
+		reg == 0x8e;			/* PLLCTL0 */
+}
+
+#endif /* __TSCS42XX_JOURNAL_H__ */
@@ -0,0 +1,731 @@
+// SPDX-License-Identifier: GPL-2.0
+// tscs42xx-coeffc.c -- TSCS42xx coefficient profile compiler
+// Copyright 2017 Tempo Semiconductor, Inc.
+//
+// Compiles a text EQ/crossover description into coefficient RAM images,
+// one per sample rate.
+
+#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "coeff.h"
+
+#define PROFILE_MAGIC "T42P"
+#define PROFILE_VERSION 1
+
+#define MAX_LINE 256
+#define MAX_FILTERS (CASCADE_BIQUAD_COUNT * 4)
+
+/* Same rates as TSCS42XX_RATES in the driver */
+static const int supported_rates[] = {
+	8000, 11025, 16000, 22050, 32000, 44100, 48000, 88200, 96000,
+};
+
+enum filter_type {
+	FILTER_PK,
+	FILTER_LS,
+	FILTER_HS,
+	FILTER_LP,
+	FILTER_HP,
+	FILTER_NO,
+	FILTER_AP,
+};
+
+static const char * const filter_names[] = {
+	[FILTER_PK] = "PK",
+	[FILTER_LS] = "LS",
+	[FILTER_HS] = "HS",
+	[FILTER_LP] = "LP",
+	[FILTER_HP] = "HP",
+	[FILTER_NO] = "NO",
+	[FILTER_AP] = "AP",
+};
+
+struct filter {
+	enum filter_type type;
+	double fc;
+	double gain;
+	double q;
+	/* Cascade index and mask of CHANNEL_L/CHANNEL_R */
+	unsigned int cascade;
+	unsigned int channels;
+	int line;
+};
+
+struct profile {
+	struct filter filters[MAX_FILTERS];
+	int filter_count;
+	double preamp[2];
+	int has_preamp[2];
+	double crossover[MBC_BAND_COUNT - 1];
+	int has_crossover;
+};
+
+struct biquad_coeffs {
+	double b0, b1, b2, a1, a2;
+};
+
+#define CHANNEL_L 0x1
+#define CHANNEL_R 0x2
+
+/* RBJ audio EQ cookbook, normalized to a0 = 1 */
+static void design(const struct filter *f, int rate, struct biquad_coeffs *c)
+{
+	double a = pow(10.0, f->gain / 40.0);
+	double w0 = 2.0 * M_PI * f->fc / rate;
+	double cw = cos(w0);
+	double alpha = sin(w0) / (2.0 * f->q);
+	double sa = 2.0 * sqrt(a) * alpha;
+	double b0, b1, b2, a0, a1, a2;
+
+	switch (f->type) {
+	case FILTER_PK:
+		b0 = 1 + alpha * a;
+		b1 = -2 * cw;
+		b2 = 1 - alpha * a;
+		a0 = 1 + alpha / a;
+		a1 = -2 * cw;
+		a2 = 1 - alpha / a;
+		break;
+	case FILTER_LS:
+		b0 = a * ((a + 1) - (a - 1) * cw + sa);
+		b1 = 2 * a * ((a - 1) - (a + 1) * cw);
+		b2 = a * ((a + 1) - (a - 1) * cw - sa);
+		a0 = (a + 1) + (a - 1) * cw + sa;
+		a1 = -2 * ((a - 1) + (a + 1) * cw);
+		a2 = (a + 1) + (a - 1) * cw - sa;
+		break;
+	case FILTER_HS:
+		b0 = a * ((a + 1) + (a - 1) * cw + sa);
+		b1 = -2 * a * ((a - 1) + (a + 1) * cw);
+		b2 = a * ((a + 1) + (a - 1) * cw - sa);
+		a0 = (a + 1) - (a - 1) * cw + sa;
+		a1 = 2 * ((a - 1) - (a + 1) * cw);
+		a2 = (a + 1) - (a - 1) * cw - sa;
+		break;
+	case FILTER_LP:
+		b0 = (1 - cw) / 2;
+		b1 = 1 - cw;
+		b2 = (1 - cw) / 2;
+		a0 = 1 + alpha;
+		a1 = -2 * cw;
+		a2 = 1 - alpha;
+		break;
+	case FILTER_HP:
+		b0 = (1 + cw) / 2;
+		b1 = -(1 + cw);
+		b2 = (1 + cw) / 2;
+		a0 = 1 + alpha;
+		a1 = -2 * cw;
+		a2 = 1 - alpha;
+		break;
+	case FILTER_NO:
+		b0 = 1;
+		b1 = -2 * cw;
+		b2 = 1;
+		a0 = 1 + alpha;
+		a1 = -2 * cw;
+		a2 = 1 - alpha;
+		break;
+	default:
+		b0 = 1 - alpha;
+		b1 = -2 * cw;
+		b2 = 1 + alpha;
+		a0 = 1 + alpha;
+		a1 = -2 * cw;
+		a2 = 1 - alpha;
+		break;
+	}
+
+	c->b0 = b0 / a0;
+	c->b1 = b1 / a0;
+	c->b2 = b2 / a0;
+	c->a1 = a1 / a0;
+	c->a2 = a2 / a0;
+}
+
+static int quantize(double val, int32_t *out)
+{
+	double q = round(val * COEFF_ONE);
+
+	if (q > COEFF_MAX || q < COEFF_MIN)
+		return -ERANGE;
+
+	*out = (int32_t)q;
+	return 0;
+}
+
+static int put_biquad(uint8_t *ram, uint8_t *used, unsigned int addr,
+	const struct biquad_coeffs *c)
+{
+	const double vals[BIQUAD_COEFF_COUNT] = {
+		c->b0, c->b1, c->b2, c->a1, c->a2,
+	};
+	int32_t q;
+	int i;
+
+	for (i = 0; i < BIQUAD_COEFF_COUNT; i++) {
+		if (quantize(vals[i], &q))
+			return -ERANGE;
+		coeff_put(ram, addr + i, q);
+		used[addr + i] = 1;
+	}
+
+	return 0;
+}
+
+static int parse_filter(char *line, struct filter *f)
+{
+	char *tok;
+	char *end;
+	int i;
+
+	/* "Filter  1: ON  PK       Fc   1000 Hz  Gain  -3.0 dB  Q  1.41" */
+	tok = strchr(line, ':');
+	if (!tok)
+		return -EINVAL;
+	tok = strtok(tok + 1, " \t");
+	if (!tok)
+		return -EINVAL;
+	if (strcmp(tok, "ON"))
+		return 1;
+
+	tok = strtok(NULL, " \t");
+	if (!tok)
+		return -EINVAL;
+	for (i = 0; i < (int)(sizeof(filter_names) / sizeof(filter_names[0]));
+	     i++)
+		if (!strcmp(tok, filter_names[i]))
+			break;
+	if (i == sizeof(filter_names) / sizeof(filter_names[0]))
+		return -ENOTSUP;
+	f->type = i;
+
+	f->fc = 0;
+	f->gain = 0;
+	f->q = M_SQRT1_2;
+	while ((tok = strtok(NULL, " \t"))) {
+		double *dst = NULL;
+
+		if (!strcmp(tok, "Fc"))
+			dst = &f->fc;
+		else if (!strcmp(tok, "Gain"))
+			dst = &f->gain;
+		else if (!strcmp(tok, "Q"))
+			dst = &f->q;
+		else
+			continue;
+
+		tok = strtok(NULL, " \t");
+		if (!tok)
+			return -EINVAL;
+		*dst = strtod(tok, &end);
+		if (end == tok)
+			return -EINVAL;
+	}
+
+	if (f->fc <= 0 || f->q <= 0 || f->gain < -24.0 || f->gain > 24.0)
+		return -ERANGE;
+
+	return 0;
+}
+
+static int parse_channels(const char *tok, unsigned int *channels)
+{
+	if (!strcmp(tok, "L"))
+		*channels = CHANNEL_L;
+	else if (!strcmp(tok, "R"))
+		*channels = CHANNEL_R;
+	else if (!strcmp(tok, "LR"))
+		*channels = CHANNEL_L | CHANNEL_R;
+	else
+		return -EINVAL;
+
+	return 0;
+}
+
+static int parse_profile(FILE *f, const char *path, struct profile *p)
+{
+	unsigned int cascade = 0;
+	unsigned int channels = CHANNEL_L | CHANNEL_R;
+	char line[MAX_LINE];
+	char *s;
+	int lineno = 0;
+	int ret;
+
+	memset(p, 0, sizeof(*p));
+
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+		s = line;
+		while (isspace((unsigned char)*s))
+			s++;
+		s[strcspn(s, "#\r\n")] = '\0';
+		if (!*s)
+			continue;
+
+		if (!strncmp(s, "Filter", 6)) {
+			struct filter *flt;
+
+			if (p->filter_count == MAX_FILTERS) {
+				fprintf(stderr, "%s:%d: too many filters\n",
+					path, lineno);
+				return -ENOSPC;
+			}
+			flt = &p->filters[p->filter_count];
+			ret = parse_filter(s, flt);
+			if (ret < 0) {
+				fprintf(stderr, "%s:%d: invalid filter (%s)\n",
+					path, lineno, strerror(-ret));
+				return ret;
+			} else if (ret > 0) {
+				continue;
+			}
+			flt->cascade = cascade;
+			flt->channels = channels;
+			flt->line = lineno;
+			p->filter_count++;
+		} else if (!strncmp(s, "Preamp:", 7)) {
+			p->preamp[cascade] = strtod(s + 7, NULL);
+			p->has_preamp[cascade] = 1;
+			if (p->preamp[cascade] > 6.0) {
+				fprintf(stderr, "%s:%d: preamp above +6 dB\n",
+					path, lineno);
+				return -ERANGE;
+			}
+		} else if (!strncmp(s, "Cascade ", 8)) {
+			cascade = strtoul(s + 8, NULL, 0) - 1;
+			if (cascade > 1) {
+				fprintf(stderr, "%s:%d: cascade must be 1 or 2\n",
+					path, lineno);
+				return -EINVAL;
+			}
+		} else if (!strncmp(s, "Channel ", 8)) {
+			if (parse_channels(s + 8, &channels)) {
+				fprintf(stderr, "%s:%d: channel must be L, R or LR\n",
+					path, lineno);
+				return -EINVAL;
+			}
+		} else if (!strncmp(s, "Crossover ", 10)) {
+			if (sscanf(s + 10, "%lf %lf", &p->crossover[0],
+				   &p->crossover[1]) != 2 ||
+			    p->crossover[0] <= 0 ||
+			    p->crossover[1] <= p->crossover[0]) {
+				fprintf(stderr, "%s:%d: crossover needs two rising frequencies\n",
+					path, lineno);
+				return -EINVAL;
+			}
+			p->has_crossover = 1;
+		} else {
+			fprintf(stderr, "%s:%d: unrecognized line\n",
+				path, lineno);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * MBC band filters from Butterworth sections. MBC1 and MBC3 cascade two
+ * identical sections for fourth order Linkwitz-Riley edges. MBC2 has only
+ * two biquads, so each of its edges is a single second order Butterworth
+ * section and the mid band overlaps its neighbours around the crossovers.
+ */
+static int compile_crossover(const struct profile *p, int rate, uint8_t *ram,
+	uint8_t *used)
+{
+	struct filter lp = { .type = FILTER_LP, .q = M_SQRT1_2 };
+	struct filter hp = { .type = FILTER_HP, .q = M_SQRT1_2 };
+	struct biquad_coeffs c;
+	int ret = 0;
+
+	lp.fc = p->crossover[0];
+	design(&lp, rate, &c);
+	ret |= put_biquad(ram, used, MBC1_ADDR, &c);
+	ret |= put_biquad(ram, used, MBC1_ADDR + BIQUAD_COEFF_COUNT, &c);
+
+	hp.fc = p->crossover[0];
+	design(&hp, rate, &c);
+	ret |= put_biquad(ram, used, MBC2_ADDR, &c);
+	lp.fc = p->crossover[1];
+	design(&lp, rate, &c);
+	ret |= put_biquad(ram, used, MBC2_ADDR + BIQUAD_COEFF_COUNT, &c);
+
+	hp.fc = p->crossover[1];
+	design(&hp, rate, &c);
+	ret |= put_biquad(ram, used, MBC3_ADDR, &c);
+	ret |= put_biquad(ram, used, MBC3_ADDR + BIQUAD_COEFF_COUNT, &c);
+
+	return ret;
+}
+
+static int compile(const struct profile *p, int rate, uint8_t *ram,
+	uint8_t *used, uint8_t *config1)
+{
+	static const unsigned int bases[2][2] = {
+		{ CASCADE1L_ADDR, CASCADE1R_ADDR },
+		{ CASCADE2L_ADDR, CASCADE2R_ADDR },
+	};
+	int slots[2][2] = { { 0 } };
+	struct biquad_coeffs c;
+	const struct filter *f;
+	unsigned int addr;
+	int32_t q = COEFF_ONE;
+	int cas, ch;
+	int i;
+
+	coeff_ram_init(ram);
+	memset(used, 0, COEFF_RAM_COEFF_COUNT);
+	*config1 = 0;
+
+	for (i = 0; i < p->filter_count; i++) {
+		f = &p->filters[i];
+		if (f->fc < rate / 2.0) {
+			design(f, rate, &c);
+		} else {
+			/* Keep the slot so later filters land in the same biquad */
+			fprintf(stderr, "line %d: Fc %.1f Hz is above Nyquist at %d Hz, passing through\n",
+				f->line, f->fc, rate);
+			c = (struct biquad_coeffs){ .b0 = 1.0 };
+		}
+
+		for (ch = 0; ch < 2; ch++) {
+			if (!(f->channels & (1 << ch)))
+				continue;
+			cas = f->cascade;
+			if (slots[cas][ch] == CASCADE_BIQUAD_COUNT) {
+				fprintf(stderr, "line %d: cascade %d%c has no free biquad\n",
+					f->line, cas + 1, ch ? 'R' : 'L');
+				return -ENOSPC;
+			}
+			addr = bases[cas][ch] +
+				slots[cas][ch]++ * BIQUAD_COEFF_COUNT;
+			if (put_biquad(ram, used, addr, &c)) {
+				fprintf(stderr, "line %d: coefficient out of range at %d Hz\n",
+					f->line, rate);
+				return -ERANGE;
+			}
+		}
+	}
+
+	/* Enable each cascade that is used, up to its last biquad */
+	for (cas = 0; cas < 2; cas++) {
+		i = slots[cas][0] > slots[cas][1] ? slots[cas][0] : slots[cas][1];
+		if (i || p->has_preamp[cas])
+			*config1 |= cas ? CONFIG1_EQ2_EN | i << 4 :
+				CONFIG1_EQ1_EN | i;
+	}
+
+	for (cas = 0; cas < 2; cas++) {
+		if (!p->has_preamp[cas])
+			continue;
+		quantize(pow(10.0, p->preamp[cas] / 20.0), &q);
+		for (ch = 0; ch < 2; ch++) {
+			addr = bases[cas][ch] + CASCADE_PRESCALE_OFFSET;
+			coeff_put(ram, addr, q);
+			used[addr] = 1;
+		}
+	}
+
+	if (p->has_crossover) {
+		if (p->crossover[1] >= rate / 2.0) {
+			fprintf(stderr, "crossover %.1f Hz is above Nyquist at %d Hz, skipping\n",
+				p->crossover[1], rate);
+		} else if (compile_crossover(p, rate, ram, used)) {
+			fprintf(stderr, "crossover coefficient out of range at %d Hz\n",
+				rate);
+			return -ERANGE;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Driver profile for the "Speaker Profile"/"Headphone Profile" controls or
+ * the tempo,*-profile firmware files, little endian:
+ *	"T42P" u16 version u16 num_regs
+ *	COEFF_RAM_SIZE bytes coefficient image, num_regs x { u8 reg, u8 val }
+ */
+static int write_profile(FILE *f, const uint8_t *ram, uint8_t config1)
+{
+	const uint8_t regs[] = { R_CONFIG1, config1 };
+	uint8_t hdr[8];
+
+	memcpy(hdr, PROFILE_MAGIC, 4);
+	hdr[4] = PROFILE_VERSION;
+	hdr[5] = 0;
+	hdr[6] = sizeof(regs) / 2;
+	hdr[7] = 0;
+	fwrite(hdr, 1, sizeof(hdr), f);
+	fwrite(ram, 1, COEFF_RAM_SIZE, f);
+	fwrite(regs, 1, sizeof(regs), f);
+
+	return ferror(f) ? -EIO : 0;
+}
+
+/* amixer -s batch that applies every control touched by the profile */
+static int write_amixer(FILE *f, const uint8_t *ram, const uint8_t *used)
+{
+	const struct coeff_ctl *ctl;
+	unsigned int i, j, k;
+	int touched;
+
+	for (i = 0; i < sizeof(coeff_ctls) / sizeof(coeff_ctls[0]); i++) {
+		ctl = &coeff_ctls[i];
+		touched = 0;
+		for (j = 0; j < ctl->count; j++)
+			touched |= used[ctl->addr + j];
+		if (!touched)
+			continue;
+
+		fprintf(f, "cset name='%s' ", ctl->name);
+		for (j = 0; j < ctl->count; j++)
+			for (k = 0; k < COEFF_SIZE; k++)
+				fprintf(f, "%s0x%02x", j || k ? "," : "",
+					ram[(ctl->addr + j) * COEFF_SIZE + k]);
+		fputc('\n', f);
+	}
+
+	return ferror(f) ? -EIO : 0;
+}
+
+enum output_format {
+	OUTPUT_PROFILE,
+	OUTPUT_FULL,
+	OUTPUT_AMIXER,
+};
+
+static int write_output(const char *prefix, int rate, enum output_format fmt,
+	const uint8_t *ram, const uint8_t *used, uint8_t config1)
+{
+	static const char * const exts[] = {
+		[OUTPUT_PROFILE] = "t42p",
+		[OUTPUT_FULL] = "img",
+		[OUTPUT_AMIXER] = "amixer",
+	};
+	char path[512];
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), "%s-%d.%s", prefix, rate, exts[fmt]);
+	f = fopen(path, "wb");
+	if (!f) {
+		perror(path);
+		return -errno;
+	}
+
+	switch (fmt) {
+	case OUTPUT_PROFILE:
+		ret = write_profile(f, ram, config1);
+		break;
+	case OUTPUT_FULL:
+		fwrite(ram, 1, COEFF_RAM_SIZE, f);
+		ret = ferror(f) ? -EIO : 0;
+		break;
+	default:
+		ret = write_amixer(f, ram, used);
+		break;
+	}
+
+	if (fclose(f) || ret) {
+		fprintf(stderr, "%s: write failed\n", path);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+/*
+ * Loudness shelves for the driver's loudness_tables: a bass low shelf and a
+ * treble high shelf per rate, boosted by one step per 6 dB of attenuation.
+ * The treble shelf passes through where its corner is too close to Nyquist.
+ */
+#define LOUDNESS_STEPS 9
+#define LOUDNESS_BASS_FC 100.0
+#define LOUDNESS_BASS_STEP_DB 1.5
+#define LOUDNESS_TREBLE_FC 10000.0
+#define LOUDNESS_TREBLE_STEP_DB 0.5
+#define LOUDNESS_MAX_FC_RATIO 0.4
+
+static int print_loudness(FILE *f)
+{
+	struct filter bass = {
+		.type = FILTER_LS, .fc = LOUDNESS_BASS_FC, .q = M_SQRT1_2,
+	};
+	struct filter treble = {
+		.type = FILTER_HS, .fc = LOUDNESS_TREBLE_FC, .q = M_SQRT1_2,
+	};
+	struct biquad_coeffs c[2];
+	int32_t q;
+	int rate, treble_on;
+	unsigned int i, step;
+	int j, k;
+
+	for (i = 0; i < sizeof(supported_rates) / sizeof(supported_rates[0]);
+	     i++) {
+		rate = supported_rates[i];
+		treble_on = LOUDNESS_TREBLE_FC < LOUDNESS_MAX_FC_RATIO * rate;
+		fprintf(f, "\t{\n\t\t.rate = %d,\n\t\t.coeffs = {\n", rate);
+		for (step = 0; step < LOUDNESS_STEPS; step++) {
+			bass.gain = step * LOUDNESS_BASS_STEP_DB;
+			treble.gain = step * LOUDNESS_TREBLE_STEP_DB;
+			design(&bass, rate, &c[0]);
+			if (treble_on)
+				design(&treble, rate, &c[1]);
+			else
+				c[1] = (struct biquad_coeffs){ .b0 = 1.0 };
+
+			if (treble_on)
+				fprintf(f, "\t\t\t/* %d dB: bass +%.1f dB, treble +%.1f dB */\n",
+					-(int)step * 6, bass.gain, treble.gain);
+			else
+				fprintf(f, "\t\t\t/* %d dB: bass +%.1f dB, treble off */\n",
+					-(int)step * 6, bass.gain);
+			fputs("\t\t\t{\n", f);
+			for (j = 0; j < 2; j++) {
+				const double vals[BIQUAD_COEFF_COUNT] = {
+					c[j].b0, c[j].b1, c[j].b2,
+					c[j].a1, c[j].a2,
+				};
+
+				fputs("\t\t\t\t", f);
+				for (k = 0; k < BIQUAD_COEFF_COUNT; k++) {
+					if (quantize(vals[k], &q))
+						return -ERANGE;
+					fprintf(f, "0x%06x,%s",
+						(unsigned int)q & 0xffffff,
+						k == BIQUAD_COEFF_COUNT - 1 ?
+						"\n" : " ");
+				}
+			}
+			fputs("\t\t\t},\n", f);
+		}
+		fputs("\t\t},\n\t},\n", f);
+	}
+
+	return ferror(f) ? -EIO : 0;
+}
+
+static const char usage_str[] =
+"usage: tscs42xx-coeffc [-h] [-r rates] [-o prefix] profile.txt\n"
+"       tscs42xx-coeffc -l\n"
+"\n"
+"where:\n"
+"    -h  show this help text\n"
+"    -r  comma separated sample rates (default: all supported rates)\n"
+"    -o  output prefix (default: profile name without extension)\n"
+"    -l  print the driver's loudness_tables entries and exit\n"
+"\n"
+"For each rate writes <prefix>-<rate>.t42p (driver profile with the\n"
+"coefficient image and R_CONFIG1, loaded in one write through the\n"
+"Speaker/Headphone Profile control or as tempo,*-profile firmware),\n"
+"<prefix>-<rate>.img (full coeff_ram image, usable with tscs42xx-eqpreview)\n"
+"and <prefix>-<rate>.amixer (per control csets for 'amixer -s').\n"
+"\n"
+"Profile syntax (REW filter lines plus directives):\n"
+"    Cascade 1|2            following filters go to EQ cascade 1 or 2\n"
+"    Channel L|R|LR         following filters go to these channels\n"
+"    Preamp: -3.0 dB        cascade prescale\n"
+"    Filter 1: ON PK Fc 1000 Hz Gain -3.0 dB Q 1.41\n"
+"                           types PK LS HS LP HP NO AP\n"
+"    Crossover 200 2000     MBC band crossovers in Hz (LR4 low and\n"
+"                           high bands, 2nd order mid band edges)\n";
+
+int main(int argc, char **argv)
+{
+	static struct profile profile;
+	static uint8_t ram[COEFF_RAM_SIZE];
+	static uint8_t used[COEFF_RAM_COEFF_COUNT];
+	uint8_t config1;
+	int rates[sizeof(supported_rates) / sizeof(supported_rates[0])];
+	int rate_count = 0;
+	char prefix[256] = "";
+	char *rate_list = NULL;
+	char *tok;
+	FILE *f;
+	int opt;
+	int ret;
+	int i, j;
+
+	while ((opt = getopt(argc, argv, "hlr:o:")) != -1) {
+		switch (opt) {
+		case 'r':
+			rate_list = optarg;
+			break;
+		case 'o':
+			snprintf(prefix, sizeof(prefix), "%s", optarg);
+			break;
+		case 'l':
+			return print_loudness(stdout) ? 1 : 0;
+		case 'h':
+			fputs(usage_str, stdout);
+			return 0;
+		default:
+			fputs(usage_str, stderr);
+			return 1;
+		}
+	}
+	if (argc - optind != 1) {
+		fputs(usage_str, stderr);
+		return 1;
+	}
+
+	if (rate_list) {
+		for (tok = strtok(rate_list, ","); tok; tok = strtok(NULL, ",")) {
+			int rate = atoi(tok);
+
+			for (j = 0; j < (int)(sizeof(rates) / sizeof(rates[0])); j++)
+				if (supported_rates[j] == rate)
+					break;
+			if (j == sizeof(rates) / sizeof(rates[0]) ||
+			    rate_count == sizeof(rates) / sizeof(rates[0])) {
+				fprintf(stderr, "Unsupported sample rate %s\n",
+					tok);
+				return 1;
+			}
+			rates[rate_count++] = rate;
+		}
+	} else {
+		for (i = 0; i < (int)(sizeof(rates) / sizeof(rates[0])); i++)
+			rates[rate_count++] = supported_rates[i];
+	}
+
+	if (!*prefix) {
+		snprintf(prefix, sizeof(prefix), "%s", argv[optind]);
+		tok = strrchr(prefix, '.');
+		if (tok && !strchr(tok, '/'))
+			*tok = '\0';
+	}
+
+	f = fopen(argv[optind], "r");
+	if (!f) {
+		perror(argv[optind]);
+		return 1;
+	}
+	ret = parse_profile(f, argv[optind], &profile);
+	fclose(f);
+	if (ret)
+		return 1;
+
+	for (i = 0; i < rate_count; i++) {
+		if (compile(&profile, rates[i], ram, used, &config1))
+			return 1;
+		if (write_output(prefix, rates[i], OUTPUT_PROFILE, ram, used,
+				 config1) ||
+		    write_output(prefix, rates[i], OUTPUT_FULL, ram, used,
+				 config1) ||
+		    write_output(prefix, rates[i], OUTPUT_AMIXER, ram, used,
+				 config1))
+			return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,372 @@
+// SPDX-License-Identifier: GPL-2.0
+// tscs42xx-eqpreview.c -- Offline preview of the TSCS42xx DAC EQ cascades
+// Copyright 2017 Tempo Semiconductor, Inc.
+//
+// Runs a WAV file through a fixed-point model of the two DAC EQ cascades
+// using a coefficient RAM image and the R_CONFIG1 value. Only the EQ is
+// modeled; the rest of the DAC DSP chain is passed through, so this is a
+// preview of an EQ profile rather than a model of the codec output.
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "coeff.h"
+
+#define SAMPLE_BITS 24
+#define SAMPLE_MAX ((1 << (SAMPLE_BITS - 1)) - 1)
+#define SAMPLE_MIN (-(1 << (SAMPLE_BITS - 1)))
+
+#define MAX_CHANNELS 2
+#define BLOCK_FRAMES 4096
+
+struct biquad {
+	int32_t b0, b1, b2, a1, a2;
+	int32_t x1, x2, y1, y2;
+};
+
+struct cascade {
+	int32_t prescale;
+	int count;
+	struct biquad bq[CASCADE_BIQUAD_COUNT];
+};
+
+struct wav {
+	int channels;
+	int rate;
+	int bits;
+	long data_offset;
+	uint32_t data_size;
+};
+
+static inline int32_t saturate(int64_t val)
+{
+	if (val > SAMPLE_MAX)
+		return SAMPLE_MAX;
+	if (val < SAMPLE_MIN)
+		return SAMPLE_MIN;
+	return (int32_t)val;
+}
+
+/* Round to nearest and drop the coefficient fraction */
+static inline int32_t coeff_shift(int64_t acc)
+{
+	return saturate((acc + (1 << (COEFF_FRAC_BITS - 1))) >>
+		COEFF_FRAC_BITS);
+}
+
+static void cascade_init(struct cascade *c, const uint8_t *ram,
+	unsigned int base, unsigned int band_enable)
+{
+	unsigned int addr;
+	int i;
+
+	memset(c, 0, sizeof(*c));
+	c->prescale = coeff_get(ram, base + CASCADE_PRESCALE_OFFSET);
+	c->count = band_enable > CASCADE_BIQUAD_COUNT ?
+		CASCADE_BIQUAD_COUNT : band_enable;
+
+	for (i = 0; i < c->count; i++) {
+		addr = base + i * BIQUAD_COEFF_COUNT;
+		c->bq[i].b0 = coeff_get(ram, addr);
+		c->bq[i].b1 = coeff_get(ram, addr + 1);
+		c->bq[i].b2 = coeff_get(ram, addr + 2);
+		c->bq[i].a1 = coeff_get(ram, addr + 3);
+		c->bq[i].a2 = coeff_get(ram, addr + 4);
+	}
+}
+
+static void biquad_run(struct biquad *bq, int32_t *buf, int frames)
+{
+	int64_t acc;
+	int32_t x;
+	int n;
+
+	for (n = 0; n < frames; n++) {
+		x = buf[n];
+		acc = (int64_t)bq->b0 * x + (int64_t)bq->b1 * bq->x1 +
+			(int64_t)bq->b2 * bq->x2 - (int64_t)bq->a1 * bq->y1 -
+			(int64_t)bq->a2 * bq->y2;
+		bq->x2 = bq->x1;
+		bq->x1 = x;
+		bq->y2 = bq->y1;
+		bq->y1 = coeff_shift(acc);
+		buf[n] = bq->y1;
+	}
+}
+
+static void cascade_run(struct cascade *c, int32_t *buf, int frames)
+{
+	int n;
+	int i;
+
+	for (n = 0; n < frames; n++)
+		buf[n] = coeff_shift((int64_t)c->prescale * buf[n]);
+
+	for (i = 0; i < c->count; i++)
+		biquad_run(&c->bq[i], buf, frames);
+}
+
+static uint32_t le32(const uint8_t *b)
+{
+	return b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static uint16_t le16(const uint8_t *b)
+{
+	return b[0] | (b[1] << 8);
+}
+
+static int wav_read_header(FILE *f, struct wav *wav)
+{
+	uint8_t hdr[12];
+	uint8_t chunk[8];
+	uint8_t fmt[16];
+	uint32_t size;
+	int have_fmt = 0;
+
+	if (fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr) ||
+	    memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4))
+		return -EINVAL;
+
+	while (fread(chunk, 1, sizeof(chunk), f) == sizeof(chunk)) {
+		size = le32(chunk + 4);
+		if (!memcmp(chunk, "fmt ", 4)) {
+			if (size < sizeof(fmt) ||
+			    fread(fmt, 1, sizeof(fmt), f) != sizeof(fmt))
+				return -EINVAL;
+			/* PCM or WAVE_FORMAT_EXTENSIBLE */
+			if (le16(fmt) != 1 && le16(fmt) != 0xfffe)
+				return -ENOTSUP;
+			wav->channels = le16(fmt + 2);
+			wav->rate = le32(fmt + 4);
+			wav->bits = le16(fmt + 14);
+			fseek(f, size - sizeof(fmt) + (size & 1), SEEK_CUR);
+			have_fmt = 1;
+		} else if (!memcmp(chunk, "data", 4)) {
+			if (!have_fmt)
+				return -EINVAL;
+			wav->data_offset = ftell(f);
+			wav->data_size = size;
+			return 0;
+		} else {
+			fseek(f, size + (size & 1), SEEK_CUR);
+		}
+	}
+
+	return -EINVAL;
+}
+
+static void wav_write_header(FILE *f, const struct wav *wav)
+{
+	int block_align = wav->channels * wav->bits / 8;
+	uint8_t hdr[44];
+
+	memcpy(hdr, "RIFF", 4);
+	memcpy(hdr + 8, "WAVEfmt ", 8);
+	memcpy(hdr + 36, "data", 4);
+
+#define PUT16(off, v) do { hdr[off] = (v) & 0xff; hdr[off + 1] = (v) >> 8; } while (0)
+#define PUT32(off, v) do { PUT16(off, (v) & 0xffff); PUT16(off + 2, (v) >> 16); } while (0)
+	PUT32(4, 36 + wav->data_size);
+	PUT32(16, 16);
+	PUT16(20, 1);
+	PUT16(22, wav->channels);
+	PUT32(24, wav->rate);
+	PUT32(28, wav->rate * block_align);
+	PUT16(32, block_align);
+	PUT16(34, wav->bits);
+	PUT32(40, wav->data_size);
+#undef PUT32
+#undef PUT16
+
+	fwrite(hdr, 1, sizeof(hdr), f);
+}
+
+/* Unpack interleaved PCM into per channel 24 bit buffers */
+static void deinterleave(const uint8_t *in, int32_t **out, int frames,
+	const struct wav *wav)
+{
+	int bytes = wav->bits / 8;
+	int32_t val;
+	int n, ch;
+
+	for (n = 0; n < frames; n++) {
+		for (ch = 0; ch < wav->channels; ch++, in += bytes) {
+			switch (bytes) {
+			case 2:
+				val = (int16_t)le16(in) * 256;
+				break;
+			case 3:
+				val = in[0] | (in[1] << 8) | (in[2] << 16);
+				val = (val ^ 0x800000) - 0x800000;
+				break;
+			default:
+				val = (int32_t)le32(in) >> 8;
+				break;
+			}
+			out[ch][n] = val;
+		}
+	}
+}
+
+static void interleave(int32_t **in, uint8_t *out, int frames,
+	const struct wav *wav)
+{
+	int bytes = wav->bits / 8;
+	uint32_t val;
+	int n, ch;
+
+	for (n = 0; n < frames; n++) {
+		for (ch = 0; ch < wav->channels; ch++, out += bytes) {
+			switch (bytes) {
+			case 2:
+				/* Round the 24 bit result back to 16 bits */
+				val = saturate((int64_t)in[ch][n] + 128) >> 8;
+				out[0] = val & 0xff;
+				out[1] = (val >> 8) & 0xff;
+				break;
+			case 3:
+				val = in[ch][n];
+				out[0] = val & 0xff;
+				out[1] = (val >> 8) & 0xff;
+				out[2] = (val >> 16) & 0xff;
+				break;
+			default:
+				val = (uint32_t)in[ch][n] << 8;
+				out[0] = val & 0xff;
+				out[1] = (val >> 8) & 0xff;
+				out[2] = (val >> 16) & 0xff;
+				out[3] = (val >> 24) & 0xff;
+				break;
+			}
+		}
+	}
+}
+
+static const char usage_str[] =
+"usage: tscs42xx-eqpreview [-h] [-c image] [-r config1] in.wav out.wav\n"
+"\n"
+"where:\n"
+"    -h  show this help text\n"
+"    -c  coefficient RAM image (618 bytes, driver coeff_ram layout)\n"
+"        defaults to the driver's power on image\n"
+"    -r  R_CONFIG1 value (EQ1/EQ2 enables and band enables)\n"
+"\n"
+"Models the prescale and biquads of EQ cascade 1 followed by cascade 2\n"
+"with 24 bit samples, 2.22 coefficients and 64 bit accumulation.\n"
+"Bass/treble enhancement, 3D, CLE, MBC and volume are not modeled, so\n"
+"the output previews the EQ alone.\n";
+
+int main(int argc, char **argv)
+{
+	static uint8_t ram[COEFF_RAM_SIZE];
+	static const unsigned int cascade1[MAX_CHANNELS] = {
+		CASCADE1L_ADDR, CASCADE1R_ADDR,
+	};
+	static const unsigned int cascade2[MAX_CHANNELS] = {
+		CASCADE2L_ADDR, CASCADE2R_ADDR,
+	};
+	struct cascade eq1[MAX_CHANNELS];
+	struct cascade eq2[MAX_CHANNELS];
+	int32_t *bufs[MAX_CHANNELS];
+	unsigned long config1 = 0;
+	const char *image = NULL;
+	struct wav wav = { 0 };
+	uint32_t remaining;
+	uint8_t *pcm;
+	FILE *in, *out;
+	int frame_bytes;
+	int frames;
+	int opt;
+	int ret;
+	int ch;
+
+	while ((opt = getopt(argc, argv, "hc:r:")) != -1) {
+		switch (opt) {
+		case 'c':
+			image = optarg;
+			break;
+		case 'r':
+			config1 = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			fputs(usage_str, stdout);
+			return 0;
+		default:
+			fputs(usage_str, stderr);
+			return 1;
+		}
+	}
+	if (argc - optind != 2) {
+		fputs(usage_str, stderr);
+		return 1;
+	}
+
+	coeff_ram_init(ram);
+	if (image && coeff_ram_load(image, ram)) {
+		fprintf(stderr, "Failed to load coefficient image %s\n", image);
+		return 1;
+	}
+
+	in = fopen(argv[optind], "rb");
+	if (!in) {
+		perror(argv[optind]);
+		return 1;
+	}
+
+	ret = wav_read_header(in, &wav);
+	if (ret || wav.channels < 1 || wav.channels > MAX_CHANNELS ||
+	    (wav.bits != 16 && wav.bits != 24 && wav.bits != 32)) {
+		fprintf(stderr, "%s: unsupported WAV (need 1-2 ch 16/24/32 bit PCM)\n",
+			argv[optind]);
+		return 1;
+	}
+
+	out = fopen(argv[optind + 1], "wb");
+	if (!out) {
+		perror(argv[optind + 1]);
+		return 1;
+	}
+
+	for (ch = 0; ch < wav.channels; ch++) {
+		cascade_init(&eq1[ch], ram, cascade1[ch],
+			CONFIG1_EQ1_BE(config1));
+		cascade_init(&eq2[ch], ram, cascade2[ch],
+			CONFIG1_EQ2_BE(config1));
+		bufs[ch] = malloc(BLOCK_FRAMES * sizeof(int32_t));
+	}
+	frame_bytes = wav.channels * wav.bits / 8;
+	pcm = malloc(BLOCK_FRAMES * frame_bytes);
+
+	wav_write_header(out, &wav);
+	fseek(in, wav.data_offset, SEEK_SET);
+
+	remaining = wav.data_size / frame_bytes;
+	while (remaining) {
+		frames = remaining < BLOCK_FRAMES ? remaining : BLOCK_FRAMES;
+		frames = fread(pcm, frame_bytes, frames, in);
+		if (frames <= 0)
+			break;
+		remaining -= frames;
+
+		deinterleave(pcm, bufs, frames, &wav);
+		for (ch = 0; ch < wav.channels; ch++) {
+			if (config1 & CONFIG1_EQ1_EN)
+				cascade_run(&eq1[ch], bufs[ch], frames);
+			if (config1 & CONFIG1_EQ2_EN)
+				cascade_run(&eq2[ch], bufs[ch], frames);
+		}
+		interleave(bufs, pcm, frames, &wav);
+
+		fwrite(pcm, frame_bytes, frames, out);
+	}
+
+	fclose(in);
+	fclose(out);
+
+	return 0;
+}
@@ -0,0 +1,352 @@
+// SPDX-License-Identifier: GPL-2.0
+// tscs42xx-journal.c -- Decode and replay TSCS42xx bus journals
+// Copyright 2017 Tempo Semiconductor, Inc.
+//
+// Reads a dump of the driver's debugfs "journal" file, prints it and
+// replays it against an emulated register file or a real device.
+
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "journal.h"
+
+#define REG_COUNT 256
+#define XFER_MAX 256
+
+/* Entries of one bus transfer merged back together */
+struct xfer {
+	uint64_t ts_ns;
+	uint32_t dur_ns;
+	uint8_t reg;
+	uint8_t path;
+	uint8_t flags;
+	int len;
+	uint8_t val[XFER_MAX];
+};
+
+struct regfile {
+	uint8_t val[REG_COUNT];
+	uint8_t known[REG_COUNT];
+};
+
+struct path_stats {
+	unsigned long xfers;
+	unsigned long bytes;
+	unsigned long errors;
+	uint64_t dur_ns;
+};
+
+static int journal_load(const char *name, struct journal_header *hdr,
+	struct journal_entry **entries)
+{
+	FILE *f;
+	size_t size;
+
+	f = strcmp(name, "-") ? fopen(name, "rb") : stdin;
+	if (!f) {
+		perror(name);
+		return -errno;
+	}
+
+	if (fread(hdr, sizeof(*hdr), 1, f) != 1 ||
+	    memcmp(hdr->magic, JOURNAL_MAGIC, sizeof(hdr->magic))) {
+		fprintf(stderr, "%s: not a journal dump\n", name);
+		return -EINVAL;
+	}
+	hdr->version = le16toh(hdr->version);
+	hdr->entry_size = le16toh(hdr->entry_size);
+	hdr->count = le32toh(hdr->count);
+	hdr->dropped = le32toh(hdr->dropped);
+	if (hdr->version != JOURNAL_VERSION ||
+	    hdr->entry_size != sizeof(struct journal_entry)) {
+		fprintf(stderr, "%s: unsupported journal version %u\n", name,
+			hdr->version);
+		return -EINVAL;
+	}
+
+	size = (size_t)hdr->count * sizeof(struct journal_entry);
+	*entries = malloc(size ? size : 1);
+	if (!*entries)
+		return -ENOMEM;
+	if (fread(*entries, 1, size, f) != size) {
+		fprintf(stderr, "%s: truncated journal\n", name);
+		return -EINVAL;
+	}
+
+	if (f != stdin)
+		fclose(f);
+
+	return 0;
+}
+
+/* Fetch the next transfer, returns the number of entries consumed */
+static unsigned int xfer_next(const struct journal_entry *e,
+	unsigned int left, struct xfer *x)
+{
+	unsigned int n = 0;
+
+	memset(x, 0, sizeof(*x));
+	x->ts_ns = le64toh(e->ts_ns);
+	x->dur_ns = le32toh(e->dur_ns);
+	x->reg = e->reg;
+	x->path = e->path;
+	x->flags = e->flags;
+
+	do {
+		if (e[n].len > sizeof(e[n].val) ||
+		    x->len + e[n].len > XFER_MAX)
+			break;
+		memcpy(&x->val[x->len], e[n].val, e[n].len);
+		x->len += e[n].len;
+		n++;
+	} while (n < left && le64toh(e[n].ts_ns) == x->ts_ns &&
+		 e[n].flags == x->flags &&
+		 e[n].reg == (uint8_t)(x->reg + x->len));
+
+	return n ? n : 1;
+}
+
+static void xfer_print(const struct xfer *x, uint64_t t0)
+{
+	uint64_t t = x->ts_ns - t0;
+	int i;
+
+	printf("%6llu.%06llu +%6uus %-9s %c%s 0x%02x:",
+		(unsigned long long)(t / 1000000000),
+		(unsigned long long)(t % 1000000000 / 1000),
+		x->dur_ns / 1000,
+		x->path < JOURNAL_PATH_COUNT ?
+			journal_path_names[x->path] : "?",
+		x->flags & JOURNAL_READ ? 'R' : 'W',
+		x->flags & JOURNAL_ERR ? "!" : " ", x->reg);
+	for (i = 0; i < x->len; i++)
+		printf(" %02x", x->val[i]);
+	putchar('\n');
+}
+
+/* Apply a transfer to the register model, returns divergent reads */
+static int emulate(struct regfile *rf, const struct xfer *x)
+{
+	int diverged = 0;
+	uint8_t reg;
+	int i;
+
+	if (x->flags & JOURNAL_ERR)
+		return 0;
+
+	for (i = 0; i < x->len; i++) {
+		reg = x->reg + i;
+		if ((x->flags & JOURNAL_READ) && rf->known[reg] &&
+		    !journal_reg_volatile(reg) && rf->val[reg] != x->val[i]) {
+			printf("diverged: reg 0x%02x read 0x%02x model 0x%02x\n",
+				reg, x->val[i], rf->val[reg]);
+			diverged++;
+		}
+		rf->val[reg] = x->val[i];
+		rf->known[reg] = 1;
+	}
+
+	return diverged;
+}
+
+/* Reissue a transfer on a real bus, returns divergent reads or -errno */
+static int replay(int fd, int addr, const struct xfer *x)
+{
+	uint8_t buf[XFER_MAX + 1];
+	struct i2c_msg msgs[2] = {
+		{ .addr = addr, .flags = 0, .buf = buf },
+		{ .addr = addr, .flags = I2C_M_RD, .buf = buf + 1 },
+	};
+	struct i2c_rdwr_ioctl_data data = { .msgs = msgs };
+	int diverged = 0;
+	uint8_t reg;
+	int i;
+
+	buf[0] = x->reg;
+	if (x->flags & JOURNAL_READ) {
+		msgs[0].len = 1;
+		msgs[1].len = x->len;
+		data.nmsgs = 2;
+	} else {
+		memcpy(buf + 1, x->val, x->len);
+		msgs[0].len = x->len + 1;
+		data.nmsgs = 1;
+	}
+
+	if (ioctl(fd, I2C_RDWR, &data) < 0)
+		return -errno;
+
+	if (!(x->flags & JOURNAL_READ))
+		return 0;
+
+	for (i = 0; i < x->len; i++) {
+		reg = x->reg + i;
+		if (!journal_reg_volatile(reg) && buf[i + 1] != x->val[i]) {
+			printf("diverged: reg 0x%02x read 0x%02x journal 0x%02x\n",
+				reg, buf[i + 1], x->val[i]);
+			diverged++;
+		}
+	}
+
+	return diverged;
+}
+
+static void sleep_ns(uint64_t ns)
+{
+	struct timespec ts = {
+		.tv_sec = ns / 1000000000,
+		.tv_nsec = ns % 1000000000,
+	};
+
+	while (nanosleep(&ts, &ts) && errno == EINTR)
+		;
+}
+
+static const char usage_str[] =
+"usage: tscs42xx-journal [-h] [-q] [-r] [-t] [-i dev -a addr] journal\n"
+"\n"
+"where:\n"
+"    -h  show this help text\n"
+"    -q  do not print the decoded transfers\n"
+"    -r  replay against an emulated register file\n"
+"    -i  replay on a real device through this i2c-dev node\n"
+"    -a  7 bit device address for -i\n"
+"    -t  keep the recorded spacing between transfers while replaying\n"
+"\n"
+"The journal is a copy of the driver's debugfs file, captured with\n"
+"journal_entries set, e.g.\n"
+"    cat /sys/kernel/debug/asoc/<card>/<codec>/journal > run.bin\n"
+"Replay applies writes and checks reads against the model or device;\n"
+"reads of volatile registers are not compared. A per path summary of\n"
+"transfers and bus time is printed at the end.\n";
+
+int main(int argc, char **argv)
+{
+	static struct path_stats stats[JOURNAL_PATH_COUNT + 1];
+	static struct regfile rf;
+	struct journal_header hdr;
+	struct journal_entry *entries;
+	struct path_stats *ps;
+	const char *dev = NULL;
+	int emulated = 0;
+	int timed = 0;
+	int quiet = 0;
+	int addr = -1;
+	int diverged = 0;
+	int fd = -1;
+	uint64_t t0 = 0;
+	uint64_t last = 0;
+	struct xfer x;
+	unsigned int i;
+	int opt;
+	int ret;
+	int n;
+
+	while ((opt = getopt(argc, argv, "hqrti:a:")) != -1) {
+		switch (opt) {
+		case 'q':
+			quiet = 1;
+			break;
+		case 'r':
+			emulated = 1;
+			break;
+		case 't':
+			timed = 1;
+			break;
+		case 'i':
+			dev = optarg;
+			break;
+		case 'a':
+			addr = strtol(optarg, NULL, 0);
+			break;
+		case 'h':
+			fputs(usage_str, stdout);
+			return 0;
+		default:
+			fputs(usage_str, stderr);
+			return 1;
+		}
+	}
+	if (argc - optind != 1 || (dev && (addr < 0 || addr > 0x7f))) {
+		fputs(usage_str, stderr);
+		return 1;
+	}
+
+	if (journal_load(argv[optind], &hdr, &entries))
+		return 1;
+
+	if (dev) {
+		fd = open(dev, O_RDWR);
+		if (fd < 0) {
+			perror(dev);
+			return 1;
+		}
+	}
+
+	printf("%u entries, %u dropped\n", hdr.count, hdr.dropped);
+	if (hdr.count)
+		t0 = le64toh(entries[0].ts_ns);
+
+	for (i = 0; i < hdr.count; i += ret) {
+		ret = xfer_next(&entries[i], hdr.count - i, &x);
+
+		ps = &stats[x.path < JOURNAL_PATH_COUNT ?
+			x.path : JOURNAL_PATH_COUNT];
+		ps->xfers++;
+		ps->bytes += x.len;
+		ps->dur_ns += x.dur_ns;
+		if (x.flags & JOURNAL_ERR)
+			ps->errors++;
+
+		if (!quiet)
+			xfer_print(&x, t0);
+
+		if (emulated)
+			diverged += emulate(&rf, &x);
+
+		if (fd >= 0 && !(x.flags & JOURNAL_ERR)) {
+			if (timed && last && x.ts_ns > last)
+				sleep_ns(x.ts_ns - last);
+			last = x.ts_ns;
+
+			n = replay(fd, addr, &x);
+			if (n < 0) {
+				fprintf(stderr, "replay failed at reg 0x%02x: %s\n",
+					x.reg, strerror(-n));
+				return 1;
+			}
+			diverged += n;
+		}
+	}
+
+	printf("\n%-9s %8s %8s %6s %12s\n", "path", "xfers", "bytes",
+		"errors", "bus time us");
+	for (i = 0; i <= JOURNAL_PATH_COUNT; i++) {
+		if (!stats[i].xfers)
+			continue;
+		printf("%-9s %8lu %8lu %6lu %12llu\n",
+			i < JOURNAL_PATH_COUNT ? journal_path_names[i] : "?",
+			stats[i].xfers, stats[i].bytes, stats[i].errors,
+			(unsigned long long)stats[i].dur_ns / 1000);
+	}
+
+	if (emulated || fd >= 0)
+		printf("\n%d divergent reads\n", diverged);
+
+	if (fd >= 0)
+		close(fd);
+	free(entries);
+
+	return diverged ? 2 : 0;
+}